@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "edgebreaker.h"
+#include "converter.h"
+#include "reader.h"
+#include "writer.h"
+#include "thread_pool.h"
+
+// Runs every stage of the pipeline on each mesh of a directory, one stage at a
+// time, and reports median and p95 times, triangles and megabytes per second
+// and the bits per vertex of the result. Results also go to a JSON file, so
+// runs of different versions can be compared.
+
+#ifndef EDGEBREAKER_DATA_DIR
+#define EDGEBREAKER_DATA_DIR "data"
+#endif
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::high_resolution_clock;
+
+struct BenchArgs {
+    std::string data = EDGEBREAKER_DATA_DIR;
+    std::string json = "edgebreaker_bench.json";
+    int runs = 10;
+    int threads = 1;
+    CompressOptions options;
+};
+
+struct Stage {
+    std::string name;
+    // Bytes the stage reads or writes, the basis of its MB/s.
+    size_t bytes = 0;
+    std::vector<double> ms;
+};
+
+struct MeshResult {
+    std::string name;
+    size_t vertices = 0;
+    size_t triangles = 0;
+    size_t components = 0;
+    BCOSizes sizes;
+    std::vector<Stage> stages;
+};
+
+#pragma region HELPERS
+
+void printUsage(const std::string& programName) {
+    std::cerr << "Usage: " << programName << " [data_dir] [--runs N] [--threads N] [--quant-bits N] "
+              << "[--clers-coder prefix|arith] [--vertex-coder raw|rans] [--json file]\n";
+}
+
+BenchArgs parseArgs(int argc, char* argv[]) {
+    BenchArgs args;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string opt = argv[i];
+            if (opt == "--runs" && i + 1 < argc) args.runs = std::stoi(argv[++i]);
+            else if (opt == "--threads" && i + 1 < argc) args.threads = std::stoi(argv[++i]);
+            else if (opt == "--quant-bits" && i + 1 < argc) args.options.quant_bits = std::stoi(argv[++i]);
+            else if (opt == "--json" && i + 1 < argc) args.json = argv[++i];
+            else if (opt == "--clers-coder" && i + 1 < argc) {
+                std::string coder = argv[++i];
+                if (coder != "prefix" && coder != "arith") throw std::invalid_argument(coder);
+                args.options.clers_coder = coder == "arith" ? CLERSCoder::ARITHMETIC : CLERSCoder::PREFIX;
+            }
+            else if (opt == "--vertex-coder" && i + 1 < argc) {
+                std::string coder = argv[++i];
+                if (coder != "raw" && coder != "rans") throw std::invalid_argument(coder);
+                args.options.vertex_coder = coder == "rans" ? VertexCoder::RANS : VertexCoder::RAW;
+            }
+            else if (opt.starts_with("--")) throw std::invalid_argument(opt);
+            else args.data = opt;
+        }
+    }
+    catch (const std::exception&) {
+        printUsage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (args.runs < 1 || args.threads < 0 || args.options.quant_bits < 0 || args.options.quant_bits > 22) {
+        printUsage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    args.options.threads = args.threads;
+    return args;
+}
+
+// Nearest rank, so p95 of a handful of runs is one of the measured times.
+double percentile(std::vector<double> ms, double p) {
+    std::sort(ms.begin(), ms.end());
+    size_t rank = static_cast<size_t>(std::ceil(p * ms.size()));
+    return ms[std::clamp<size_t>(rank, 1, ms.size()) - 1];
+}
+
+double timed(const std::function<void()>& f) {
+    auto start = Clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+std::string escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+#pragma endregion
+
+MeshResult benchMesh(const fs::path& path, const BenchArgs& args, ThreadPool& pool) {
+    MeshResult result;
+    result.name = path.filename().string();
+    bool obj = path.extension() == ".obj";
+    size_t file_size = fs::file_size(path);
+    fs::path mesh_out = fs::temp_directory_path() / "edgebreaker_bench.obj";
+
+    enum { PARSE, SPLIT, TO_OVX, COMPRESS, WRITE, READ, DECOMPRESS_WRAPZIP, DECOMPRESS_REVERSI, FROM_OVX, MESH_WRITE };
+    for (const char* name : { "parse", "split", "toOVX", "compress", "bco_write", "bco_read",
+                              "decompress_wrapzip", "decompress_reversi", "fromOVX", "mesh_write" }) {
+        result.stages.push_back({ name, 0, {} });
+    }
+
+    // One extra run first, untimed, to warm caches and the allocator.
+    for (int run = -1; run < args.runs; ++run) {
+        std::vector<double> ms(result.stages.size());
+
+        std::vector<Vertex> vert;
+        std::vector<Indices> tri;
+        ms[PARSE] = timed([&]{
+            std::tie(vert, tri) = obj ? Reader::read_OBJ(path.string(), &pool) : Reader::read_OFF(path.string());
+        });
+
+        Quantization quant;
+        if (args.options.quant_bits > 0) quant = Converter::quantize(vert, args.options.quant_bits);
+
+        ms[SPLIT] = timed([&]{
+            auto split = Converter::splitIntoComponents(vert.size(), tri, &pool);
+        });
+
+        // toOVX splits again: it is timed as the whole conversion.
+        std::vector<std::tuple<std::vector<int>, std::vector<int>, std::vector<Dummy>>> built;
+        ms[TO_OVX] = timed([&]{
+            built = Converter::toOVX(vert, tri, &pool);
+        });
+
+        std::vector<std::tuple<std::span<const int>, std::span<const int>, std::span<const Dummy>>> ovx;
+        for (auto& [V, O, dummy] : built) {
+            ovx.emplace_back(V, O, dummy);
+        }
+        std::vector<std::tuple<std::vector<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>> compressed(ovx.size());
+        std::vector<ComponentInfo> info(ovx.size());
+        ms[COMPRESS] = timed([&]{
+            EdgeBreaker::compressComponents(vert, ovx, quant, compressed, info, &pool);
+        });
+
+        std::vector<uint8_t> bco;
+        ms[WRITE] = timed([&]{
+            BCOStreamWriter writer(bco, compressed.size(), quant, args.options.clers_coder, args.options.vertex_coder);
+            for (size_t i = 0; i < compressed.size(); ++i) {
+                auto& [vertices, clers, handles, dummy] = compressed[i];
+                writer.append(vertices, clers, handles, dummy, info[i]);
+            }
+            result.sizes = writer.finish();
+        });
+
+        std::pair<Quantization, std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>>> read;
+        ms[READ] = timed([&]{
+            read = Reader::read_Compressed_BIN(std::span<const uint8_t>(bco));
+        });
+
+        // Decoding consumes the read components, so each decoder gets its own copy.
+        auto reversi_input = read.second;
+        std::vector<std::tuple<std::vector<Vertex>, std::vector<int>, std::vector<int>, std::vector<Dummy>>> decoded;
+        ms[DECOMPRESS_WRAPZIP] = timed([&]{
+            decoded = EdgeBreaker::decompressComponents(read.second, read.first, ConnectivityDecoder::WRAP_ZIP, &pool).first;
+        });
+        ms[DECOMPRESS_REVERSI] = timed([&]{
+            auto reversed = EdgeBreaker::decompressComponents(reversi_input, read.first, ConnectivityDecoder::SPIRALE_REVERSI, &pool).first;
+        });
+
+        std::pair<std::vector<Vertex>, std::vector<Indices>> mesh;
+        ms[FROM_OVX] = timed([&]{
+            mesh = Converter::fromOVX(decoded, &pool);
+        });
+
+        ms[MESH_WRITE] = timed([&]{
+            Writer::write_OBJ(mesh_out.string(), mesh.first, mesh.second);
+        });
+
+        if (run < 0) {
+            result.vertices = mesh.first.size();
+            result.triangles = mesh.second.size();
+            result.components = compressed.size();
+            // Parsing reads the file, the BCO stages move the encoded bytes and
+            // the mesh write produces a text file; the rest is measured against
+            // the raw mesh of 12 bytes per vertex and per triangle.
+            size_t raw = 12 * (mesh.first.size() + mesh.second.size());
+            for (auto& stage : result.stages) stage.bytes = raw;
+            result.stages[PARSE].bytes = file_size;
+            result.stages[WRITE].bytes = bco.size();
+            result.stages[READ].bytes = bco.size();
+            result.stages[MESH_WRITE].bytes = fs::file_size(mesh_out);
+            continue;
+        }
+        for (size_t s = 0; s < ms.size(); ++s) {
+            result.stages[s].ms.push_back(ms[s]);
+        }
+    }
+    fs::remove(mesh_out);
+    return result;
+}
+
+void writeJSON(const std::string& outfile, const BenchArgs& args, const std::vector<MeshResult>& results) {
+    std::ofstream out(outfile);
+    if (!out) throw WriterException(std::format("Cannot write to file {}!", outfile));
+
+    out << "{\n";
+    out << std::format("  \"runs\": {},\n  \"threads\": {},\n  \"quant_bits\": {},\n", args.runs, args.threads, args.options.quant_bits);
+    out << std::format("  \"clers_coder\": \"{}\",\n  \"vertex_coder\": \"{}\",\n",
+        args.options.clers_coder == CLERSCoder::ARITHMETIC ? "arith" : "prefix",
+        args.options.vertex_coder == VertexCoder::RANS ? "rans" : "raw");
+    out << "  \"meshes\": [\n";
+    for (size_t m = 0; m < results.size(); ++m) {
+        auto& r = results[m];
+        out << "    {\n";
+        out << std::format("      \"name\": \"{}\",\n      \"vertices\": {},\n      \"triangles\": {},\n      \"components\": {},\n",
+            escape(r.name), r.vertices, r.triangles, r.components);
+        out << std::format("      \"bco_bytes\": {},\n      \"bits_per_vertex\": {:.4f},\n      \"geometry_bits_per_vertex\": {:.4f},\n      \"connectivity_bits_per_triangle\": {:.4f},\n",
+            r.sizes.total, r.sizes.total * 8.0 / std::max<size_t>(r.vertices, 1),
+            r.sizes.geometry * 8.0 / std::max<size_t>(r.sizes.vertices, 1),
+            r.sizes.connectivity * 8.0 / std::max<size_t>(r.sizes.triangles, 1));
+        out << "      \"stages\": {\n";
+        for (size_t s = 0; s < r.stages.size(); ++s) {
+            auto& stage = r.stages[s];
+            double median = percentile(stage.ms, 0.5);
+            out << std::format("        \"{}\": {{ \"median_ms\": {:.4f}, \"p95_ms\": {:.4f}, \"triangles_per_s\": {:.0f}, \"mb_per_s\": {:.2f} }}{}\n",
+                stage.name, median, percentile(stage.ms, 0.95),
+                r.triangles / std::max(median, 1e-6) * 1000, stage.bytes / 1e6 / std::max(median, 1e-6) * 1000,
+                s + 1 < r.stages.size() ? "," : "");
+        }
+        out << "      }\n";
+        out << (m + 1 < results.size() ? "    },\n" : "    }\n");
+    }
+    out << "  ]\n}\n";
+    if (!out) throw WriterException(std::format("Cannot write to file {}!", outfile));
+}
+
+int main(int argc, char* argv[]) {
+    auto args = parseArgs(argc, argv);
+
+    std::vector<fs::path> meshes;
+    for (auto& entry : fs::directory_iterator(args.data)) {
+        auto ext = entry.path().extension();
+        if (entry.is_regular_file() && (ext == ".obj" || ext == ".off")) {
+            meshes.push_back(entry.path());
+        }
+    }
+    std::sort(meshes.begin(), meshes.end());
+    if (meshes.empty()) {
+        std::cerr << std::format("No .obj or .off meshes in {}\n", args.data);
+        return EXIT_FAILURE;
+    }
+
+    ThreadPool pool(args.threads);
+    std::vector<MeshResult> results;
+    for (auto& path : meshes) {
+        auto& r = results.emplace_back(benchMesh(path, args, pool));
+
+        std::cout << std::format("{}: {} triangles, {} components, {:.2f} bits per vertex\n",
+            r.name, r.triangles, r.components, r.sizes.total * 8.0 / std::max<size_t>(r.vertices, 1));
+        std::cout << std::format("  {:<20}{:>12}{:>12}{:>14}{:>10}\n", "stage", "median ms", "p95 ms", "Mtri/s", "MB/s");
+        for (auto& stage : r.stages) {
+            double median = percentile(stage.ms, 0.5);
+            std::cout << std::format("  {:<20}{:>12.3f}{:>12.3f}{:>14.2f}{:>10.1f}\n",
+                stage.name, median, percentile(stage.ms, 0.95),
+                r.triangles / std::max(median, 1e-6) / 1000, stage.bytes / 1e6 / std::max(median, 1e-6) * 1000);
+        }
+    }
+
+    writeJSON(args.json, args, results);
+    std::cout << std::format("Wrote {}\n", args.json);
+    return 0;
+}
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "types.h"
 
@@ -11,11 +12,20 @@ struct Args {
     std::string outfile;
     File::Type infile_type;
     File::Type outfile_type;
+    int threads = 1;
+    int quant_bits = 0;
+    CLERSCoder clers_coder = CLERSCoder::PREFIX;
+    VertexCoder vertex_coder = VertexCoder::RAW;
+    ConnectivityDecoder decoder = ConnectivityDecoder::WRAP_ZIP;
+    bool stream = false;
+    bool stats = false;
+    std::vector<size_t> components;
 };
 
 void printUsage(const std::string& programName);
 void printUsageCompress(const std::string& programName);
 void printUsageDecompress(const std::string& programName);
+void printUsageBatch(const std::string& programName);
 void printUsageOVX(const std::string& programName);
 
 File::Type findFileType(const std::string& fileName);
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+struct BatchJob {
+    std::string infile;
+    std::string outfile;
+    File::Type infile_type;
+    File::Type outfile_type;
+};
+
+// Lists the files of a batch. source is a directory (every .obj, .off and
+// .ovx file in it), a pattern with * or ? in its last part ("assets/*.obj"),
+// or a manifest with one input per line, optionally followed by a tab and its
+// output. Relative manifest inputs are taken from the manifest's directory;
+// outputs default to <outdir>/<input stem>.bco and relative ones are placed
+// under outdir. Blank lines and lines starting with # are skipped. Throws
+// ReaderException if the source cannot be read.
+std::vector<BatchJob> listBatch(const std::string& source, const std::string& outdir);
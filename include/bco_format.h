@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// BCO container: MAGIC, a version byte, a flags byte and ENDIAN stored in the
+// writer's byte order, then varint counts and the per-component sections.
+// Floats are stored raw, so a file with a foreign ENDIAN is rejected.
+//
+// The components are followed by an index with one IndexEntry per component
+// and a Footer at the very end, so a reader can seek straight to the
+// components it wants. A sequential reader stops after the last component
+// and never looks at the index.
+struct BCOFormat {
+    static constexpr char MAGIC[4] = { 'E', 'B', 'C', 'O' };
+    static constexpr char INDEX_MAGIC[4] = { 'E', 'B', 'I', 'X' };
+    static constexpr uint8_t VERSION = 4;
+    static constexpr uint16_t ENDIAN = 0x0102;
+
+    // Residuals are grid integers stored as zigzag varints; the header
+    // carries the bit count, the grid origin and the step.
+    static constexpr uint8_t QUANTIZED = 1 << 0;
+
+    // CLERS strings are range coded (CLERSModel) instead of prefix coded.
+    static constexpr uint8_t ARITHMETIC_CLERS = 1 << 1;
+
+    // Every component starts its residuals with a byte telling whether they
+    // are rANS coded (see residual_coder.h) or stored raw.
+    static constexpr uint8_t RANS_VERTICES = 1 << 2;
+
+    // Components smaller than this keep raw residuals, where the frequency
+    // tables would cost more than they save.
+    static constexpr size_t RANS_MIN_VERTICES = 256;
+
+    // Offsets are in bytes from the start of the file. Counts and bounds are
+    // those of the decoded component, dummies excluded.
+    struct IndexEntry {
+        uint64_t offset;
+        uint64_t size;
+        uint64_t triangles;
+        uint64_t vertices;
+        float min[3];
+        float max[3];
+    };
+
+    struct Footer {
+        uint64_t index_offset;
+        uint64_t components;
+        char magic[4];
+        uint32_t reserved;
+    };
+};
+
+static_assert(sizeof(BCOFormat::IndexEntry) == 56);
+static_assert(sizeof(BCOFormat::Footer) == 24);
+
+// Bytes a written BCO file spends on each part. Connectivity covers the CLERS
+// strings, handles and dummies, geometry the vertex residuals.
+struct BCOSizes {
+    size_t connectivity = 0;
+    size_t geometry = 0;
+    size_t total = 0;
+    size_t vertices = 0;
+    size_t triangles = 0;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "reader.h"
+
+// Growable output buffer with LEB128 varints, so whole sections can be
+// assembled in memory and written in one go.
+class ByteWriter {
+public:
+    void put(const void* data, size_t size) {
+        auto bytes = static_cast<const uint8_t*>(data);
+        _data.insert(_data.end(), bytes, bytes + size);
+    }
+
+    void putByte(uint8_t b) {
+        _data.push_back(b);
+    }
+
+    void putVarint(uint64_t v) {
+        while(v >= 0x80){
+            _data.push_back(static_cast<uint8_t>(v) | 0x80);
+            v >>= 7;
+        }
+        _data.push_back(static_cast<uint8_t>(v));
+    }
+
+    void putSigned(int64_t v) {
+        putVarint((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+    }
+
+    void clear() {
+        _data.clear();
+    }
+
+    const std::vector<uint8_t>& data() const { return _data; }
+    std::vector<uint8_t>& data() { return _data; }
+    size_t size() const { return _data.size(); }
+private:
+    std::vector<uint8_t> _data;
+};
+
+// Cursor over a byte range. Reading past the end throws ReaderException.
+class ByteReader {
+public:
+    ByteReader(const uint8_t* data, size_t size) : _p(data), _end(data + size) {}
+
+    const uint8_t* take(size_t size) {
+        if(size > remaining()) throw ReaderException("Unexpected end of compressed data");
+        auto p = _p;
+        _p += size;
+        return p;
+    }
+
+    uint8_t getByte() {
+        return *take(1);
+    }
+
+    uint64_t getVarint() {
+        uint64_t v = 0;
+        for(int shift = 0; shift < 64; shift += 7){
+            uint8_t b = getByte();
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if(!(b & 0x80)) return v;
+        }
+        throw ReaderException("Invalid varint in compressed data");
+    }
+
+    int64_t getSigned() {
+        uint64_t v = getVarint();
+        return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+    }
+
+    // Varint that is also used as an element count, checked against what is
+    // left so a corrupt file cannot trigger a huge allocation.
+    size_t getCount(size_t element = 1) {
+        uint64_t v = getVarint();
+        if(v > remaining() / element) throw ReaderException("Invalid count in compressed data");
+        return static_cast<size_t>(v);
+    }
+
+    size_t remaining() const { return _end - _p; }
+    const uint8_t* position() const { return _p; }
+private:
+    const uint8_t* _p;
+    const uint8_t* _end;
+};
+
+// MSB-first bit packing for values of up to 32 bits.
+class BitWriter {
+public:
+    void put(uint32_t value, int bits) {
+        if(bits == 0) return;
+        _buffer = (_buffer << bits) | (value & ((1ull << bits) - 1));
+        _count += bits;
+        while(_count >= 8){
+            _count -= 8;
+            _data.push_back(static_cast<uint8_t>(_buffer >> _count));
+        }
+    }
+
+    const std::vector<uint8_t>& finish() {
+        if(_count > 0){
+            _data.push_back(static_cast<uint8_t>(_buffer << (8 - _count)));
+            _count = 0;
+        }
+        return _data;
+    }
+private:
+    uint64_t _buffer = 0;
+    int _count = 0;
+    std::vector<uint8_t> _data;
+};
+
+// Reads what BitWriter wrote. Past the end it yields zero bits.
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : _p(data), _end(data + size) {}
+
+    uint32_t get(int bits) {
+        if(_count < bits){
+            while(_count <= 56){
+                _buffer = (_buffer << 8) | (_p < _end ? *_p++ : 0);
+                _count += 8;
+            }
+        }
+        _count -= bits;
+        return static_cast<uint32_t>((_buffer >> _count) & ((1ull << bits) - 1));
+    }
+private:
+    uint64_t _buffer = 0;
+    int _count = 0;
+    const uint8_t* _p;
+    const uint8_t* _end;
+};
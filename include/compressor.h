@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <tuple>
+#include <span>
 
 #include "types.h"
 
@@ -14,9 +15,10 @@
 class Compressor{
 public:
     Compressor(
-        const std::vector<Vertex>& vert,
-        const std::vector<int>& V,
-        const std::vector<int>& O
+        std::span<const Vertex> vert,
+        std::span<const int> V,
+        std::span<const int> O,
+        const Quantization& quant = {}
     ); 
 public:
     void compress(
@@ -26,15 +28,28 @@ public:
         std::vector<Handle>& handles,
         std::vector<Dummy>& dummy
     );
+    // Counts and bounding box of what the last compress() call decodes to.
+    ComponentInfo info() const;
+    // How often each PredictionCase was used by the last compress() call.
+    const std::array<size_t, PREDICTION_CASES>& predictionCases() const { return _cases; }
 private:
     int _T = 0;
     std::vector<int> _M;
     std::vector<int> _U;   
     std::vector<Vertex> _D;
 
-    const std::vector<Vertex>& _G;
-    const std::vector<int>& _V;
-    const std::vector<int>& _O;
+    // Vertices are renumbered to the component, so _G and _V are local.
+    // _L maps a local vertex back to the mesh, _S to its dummy slot or -1.
+    std::vector<Vertex> _G;
+    std::vector<int> _V;
+    std::vector<int> _L;
+    std::vector<int> _S;
+    std::vector<int> _stack;
+    std::array<size_t, PREDICTION_CASES> _cases{};
+
+    std::span<const int> _O;
+    Quantization _quant;
+    bool _quantized;
 private:
     void _compress(
         int c,
@@ -3,16 +3,67 @@
 #include <iostream>
 #include <vector>
 #include <tuple>
+#include <span>
 
 #include "types.h"
+#include "thread_pool.h"
 
 class Converter {
 public:
     static std::vector<std::tuple<std::vector<int>, std::vector<int>, std::vector<Dummy>>> toOVX(
         std::vector<Vertex>& vert, 
-        std::vector<Indices>& tri
+        std::vector<Indices>& tri,
+        ThreadPool* pool = nullptr
+    );
+    // Same as above, but into tables the caller keeps, reusing their capacity.
+    static void toOVX(
+        std::vector<Vertex>& vert,
+        std::vector<Indices>& tri,
+        std::vector<std::tuple<std::vector<int>, std::vector<int>, std::vector<Dummy>>>& result,
+        ThreadPool* pool = nullptr
+    );
+    // The triangles grouped by connected component, and where each one starts.
+    static std::pair<std::vector<Indices>, std::vector<size_t>> splitIntoComponents(
+        int vert_size,
+        const std::vector<Indices>& tri,
+        ThreadPool* pool = nullptr
     );
     static std::pair<std::vector<Vertex>, std::vector<Indices>> fromOVX(
-        const std::vector<std::tuple<std::vector<Vertex>, std::vector<int>, std::vector<int>, std::vector<Dummy>>>& ovx
+        const std::vector<std::tuple<std::vector<Vertex>, std::vector<int>, std::vector<int>, std::vector<Dummy>>>& ovx,
+        ThreadPool* pool = nullptr
+    );
+    static Quantization quantize(
+        std::span<const Vertex> vert,
+        int bits
+    );
+    static void dequantize(
+        std::vector<Vertex>& vert,
+        const Quantization& quant
+    );
+};
+
+// Builds the same components as Converter::toOVX, in the same order, but one
+// at a time, so only the tables of the component being built are held. The
+// triangles are taken over; dummy vertices are appended to vert as their
+// component comes up.
+class OVXStream {
+public:
+    OVXStream(
+        std::vector<Vertex>& vert,
+        std::vector<Indices>&& tri,
+        ThreadPool* pool = nullptr
+    );
+public:
+    size_t size() const { return _offsets.size() - 1; }
+    bool next(
+        std::vector<int>& V,
+        std::vector<int>& O,
+        std::vector<Dummy>& dummy
     );
-};
\ No newline at end of file
+private:
+    std::vector<Vertex>& _vert;
+    std::vector<Indices> _tri;
+    std::vector<size_t> _offsets;
+    size_t _next = 0;
+    ThreadPool* _pool;
+};
@@ -3,8 +3,10 @@
 #include <vector>
 #include <tuple>
 #include <queue>
+#include <cstddef>
 
 #include "types.h"
+#include "handle_stream.h"
 
 #define N(c) (3 * ((c) / 3) + ((c) + 1) % 3)
 #define P(c) (N(N(c)))
@@ -17,7 +19,9 @@ public:
     Decompressor(
         std::queue<Vertex>& vertices, 
         std::pair<int, std::vector<CLERS>>& clers,
-        const std::vector<Handle>& handles
+        const HandleStream& handles,
+        bool quantized = false,
+        ConnectivityDecoder decoder = ConnectivityDecoder::WRAP_ZIP
     ); 
 public:
     void decompress(
@@ -25,24 +29,42 @@ public:
         std::vector<int>& _V,
         std::vector<int>& _O
     );
+    size_t peakStackBytes() const;
+    // How often each PredictionCase was used.
+    const std::array<size_t, PREDICTION_CASES>& predictionCases() const { return _cases; }
 private:
     std::queue<Vertex>& _vertices; 
     std::vector<CLERS> _clers;
-    const std::vector<Handle>& _H;
+    HandleCursor _H;
+    bool _quantized;
+    ConnectivityDecoder _decoder;
 
     int _T = 0;
     int _N = 2;
-    int _A = 0;
 
     std::vector<int> _M;
     std::vector<int> _U;
 
+    // Pending S branches of the traversal passes, reused by both of them.
+    std::vector<int> _stack;
+    size_t _peak = 0;
+    std::array<size_t, PREDICTION_CASES> _cases{};
+
 private:
     void _decompressConectivity(
         int c,
         std::vector<int>& _V,
         std::vector<int>& _O
     );
+    void _decompressReversi(
+        std::vector<int>& _V,
+        std::vector<int>& _O
+    );
+    void _labelVertices(
+        std::vector<int>& _V,
+        std::vector<int>& _O
+    );
+    void _push(int c);
     void _decompressVertices(
         int c,
         std::vector<Vertex>& _G,
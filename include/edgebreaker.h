@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <span>
+#include <tuple>
+#include <vector>
+
+#include "types.h"
+#include "bco_format.h"
+#include "thread_pool.h"
+#include "reader.h"
+#include "stats.h"
+
+// Options of EdgeBreaker::compress, the same as those of the compress mode.
+struct CompressOptions {
+    int threads = 1;
+    int quant_bits = 0;
+    CLERSCoder clers_coder = CLERSCoder::PREFIX;
+    VertexCoder vertex_coder = VertexCoder::RAW;
+};
+
+// Options of EdgeBreaker::decompress. An empty components list decodes every
+// component; otherwise only the listed ones, in the listed order.
+struct DecompressOptions {
+    int threads = 1;
+    ConnectivityDecoder decoder = ConnectivityDecoder::WRAP_ZIP;
+    std::vector<size_t> components;
+};
+
+// A mesh on its way through compression. buildMesh fills the corner tables
+// from vert and tri, mapMesh points the views at a mapped OVX file instead;
+// compressMesh then fills compressed and info. Keeping one around between
+// meshes reuses the capacity of every vector.
+struct CompressBuffers {
+    std::vector<Vertex> vert;
+    std::vector<Indices> tri;
+    std::vector<std::tuple<std::vector<int>, std::vector<int>, std::vector<Dummy>>> built;
+    // What compressMesh reads: vert and built, or the mapped file.
+    std::span<const Vertex> view;
+    std::vector<std::tuple<std::span<const int>, std::span<const int>, std::span<const Dummy>>> ovx;
+    Quantization quant;
+    std::vector<std::tuple<std::vector<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>> compressed;
+    std::vector<ComponentInfo> info;
+};
+
+// Called after every finished component with the number done so far and the
+// total. Calls are serialized, so it may print.
+using Progress = std::function<void(size_t, size_t)>;
+
+// The library's entry points. compress and decompress go from a triangle mesh
+// to a BCO buffer and back without touching the disk; the component stages
+// are what they are built from, for callers that bring their own corner
+// tables or keep the CLERS strings.
+class EdgeBreaker {
+public:
+    static BCOSizes compress(
+        std::span<const Vertex> vert,
+        std::span<const Indices> tri,
+        std::vector<uint8_t>& out,
+        const CompressOptions& options = {}
+    );
+    static void decompress(
+        std::span<const uint8_t> data,
+        std::vector<Vertex>& vert,
+        std::vector<Indices>& tri,
+        const DecompressOptions& options = {}
+    );
+
+    // Computes buffers.quant, the grid over buffers.vert, when quant_bits > 0,
+    // then builds the corner tables, appending hole-filling dummies to vert.
+    // stats, when given, gets the toOVX time.
+    static void buildMesh(
+        CompressBuffers& buffers,
+        int quant_bits,
+        ThreadPool* pool = nullptr,
+        Stats* stats = nullptr
+    );
+    // Computes buffers.quant over a mapped OVX file and views it; the file
+    // has to outlive buffers.
+    static void mapMesh(
+        CompressBuffers& buffers,
+        const MappedOVX& mapped,
+        int quant_bits
+    );
+    // Compresses what buildMesh or mapMesh prepared. stats, when given, gets
+    // the compress time and the counters of every component.
+    static void compressMesh(
+        CompressBuffers& buffers,
+        ThreadPool* pool = nullptr,
+        const Progress& progress = {},
+        Stats* stats = nullptr
+    );
+    // Computes buffers.quant and compresses buffers.vert and buffers.tri, or
+    // the mapped file when there is one, straight into a BCO file, building,
+    // compressing and appending a batch of components at a time. Peak memory
+    // then follows the largest batch, not the scene; the file is the same.
+    static BCOSizes compressStream(
+        CompressBuffers& buffers,
+        const MappedOVX* mapped,
+        const std::string& outfile,
+        const CompressOptions& options,
+        ThreadPool* pool = nullptr,
+        const Progress& progress = {},
+        Stats* stats = nullptr
+    );
+
+    // Compresses ovx[i] into compressed[i] and info[i], largest first. The
+    // outputs must be as long as ovx; their buffers are cleared and reused.
+    // stats, when not empty, gets the counters of every component.
+    static void compressComponents(
+        std::span<const Vertex> vert,
+        std::span<const std::tuple<std::span<const int>, std::span<const int>, std::span<const Dummy>>> ovx,
+        const Quantization& quant,
+        std::span<std::tuple<std::vector<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>> compressed,
+        std::span<ComponentInfo> info,
+        ThreadPool* pool = nullptr,
+        const Progress& progress = {},
+        std::span<ComponentStats> stats = {}
+    );
+    // Decodes every component into its vertices, V and O tables and dummies,
+    // dequantized. Returns them with the peak traversal stack in bytes. stats,
+    // when not empty, gets the counters of every component.
+    static std::pair<std::vector<std::tuple<std::vector<Vertex>, std::vector<int>, std::vector<int>, std::vector<Dummy>>>, size_t> decompressComponents(
+        std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>>& uncompressed,
+        const Quantization& quant,
+        ConnectivityDecoder decoder = ConnectivityDecoder::WRAP_ZIP,
+        ThreadPool* pool = nullptr,
+        const Progress& progress = {},
+        std::span<ComponentStats> stats = {}
+    );
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <climits>
+
+#include "types.h"
+#include "byte_stream.h"
+
+// The compressor finds handles in triangle order, so their second corners
+// increase and the first corner always lies before the second. Each handle is
+// stored as the gap to the previous second corner and the distance back to
+// its first corner, both as varints; most take two bytes.
+inline HandleStream encodeHandles(const std::vector<Handle>& handles) {
+    ByteWriter out;
+    int last = 0;
+    for(auto& h : handles){
+        out.putVarint(static_cast<uint32_t>(h[1] - last));
+        out.putVarint(static_cast<uint32_t>(h[1] - h[0]));
+        last = h[1];
+    }
+    return { handles.size(), std::move(out.data()) };
+}
+
+// Decodes a HandleStream front to back, one handle at a time.
+class HandleCursor {
+public:
+    explicit HandleCursor(const HandleStream& handles) : _in(handles.data.data(), handles.data.size()), _left(handles.count) {
+        if(_left > 0) _read();
+    }
+
+    bool empty() const { return _left == 0; }
+    const Handle& front() const { return _handle; }
+
+    void pop() {
+        if(--_left > 0) _read();
+    }
+private:
+    ByteReader _in;
+    size_t _left;
+    Handle _handle = {0, 0};
+    int64_t _last = 0;
+private:
+    void _read() {
+        uint64_t gap = _in.getVarint();
+        uint64_t back = _in.getVarint();
+        if(gap > INT_MAX || back > INT_MAX) throw ReaderException("Invalid handle");
+        int64_t second = _last + static_cast<int64_t>(gap);
+        int64_t first = second - static_cast<int64_t>(back);
+        if(first < 0 || second > INT_MAX) throw ReaderException("Invalid handle");
+        _handle = { static_cast<int>(first), static_cast<int>(second) };
+        _last = second;
+    }
+};
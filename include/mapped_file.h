@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. Like std::ifstream, a file that
+// cannot be opened leaves the object in a false state instead of throwing.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+public:
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+    explicit operator bool() const { return _open; }
+private:
+    const char* _data = nullptr;
+    size_t _size = 0;
+    bool _open = false;
+#ifdef _WIN32
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+#endif
+private:
+    void _close();
+};
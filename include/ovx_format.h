@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#include "types.h"
+
+// Binary OVX layout: a header, a component table and the V, O, dummy and
+// vertex arrays of all components back to back. Every section starts on an
+// ALIGNMENT boundary so a mapped file can be used in place.
+struct OVXFormat {
+    static constexpr char MAGIC[4] = { 'O', 'V', 'X', 'B' };
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t ENDIAN = 0x01020304;
+    static constexpr uint64_t ALIGNMENT = 64;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t endian;
+        uint32_t reserved;
+        uint64_t components;
+        uint64_t corners;
+        uint64_t dummies;
+        uint64_t vertices;
+        uint64_t table_offset;
+        uint64_t V_offset;
+        uint64_t O_offset;
+        uint64_t dummy_offset;
+        uint64_t vert_offset;
+    };
+
+    // Offsets are element indices into the shared arrays.
+    struct Component {
+        uint64_t corner_offset;
+        uint64_t corner_count;
+        uint64_t dummy_offset;
+        uint64_t dummy_count;
+    };
+
+    static constexpr uint64_t align(uint64_t offset) {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+};
+
+static_assert(sizeof(Vertex) == 3 * sizeof(float));
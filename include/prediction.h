@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "types.h"
+
+inline PredictionCase predictionCase(bool a, bool b, bool d) {
+    if(d && b) return PredictionCase::ABD;
+    if(d) return PredictionCase::AD;
+    if(a && b) return PredictionCase::AB;
+    if(a) return PredictionCase::A;
+    if(b) return PredictionCase::B;
+    return PredictionCase::NONE;
+}
+
+inline Vertex predict(PredictionCase k, const Vertex& a, const Vertex& b, const Vertex& d) {
+    switch(k){
+    case PredictionCase::ABD: return a + b - d;
+    case PredictionCase::AD: return 2.0f * a - d;
+    case PredictionCase::AB: return (a + b) / 2.0f;
+    case PredictionCase::A: return a;
+    case PredictionCase::B: return b;
+    default: return Vertex({0, 0, 0});
+    }
+}
+
+// Same cases on grid coordinates, which quantized meshes carry as integral
+// floats. Everything is exact in int64, so encoder and decoder cannot drift.
+inline Vertex predictQuantized(PredictionCase k, const Vertex& a, const Vertex& b, const Vertex& d) {
+    Vertex pred;
+    for(int i = 0; i < 3; ++i){
+        int64_t ai = static_cast<int64_t>(a[i]), bi = static_cast<int64_t>(b[i]), di = static_cast<int64_t>(d[i]);
+        int64_t p = 0;
+        switch(k){
+        case PredictionCase::ABD: p = ai + bi - di; break;
+        case PredictionCase::AD: p = 2 * ai - di; break;
+        case PredictionCase::AB: p = (ai + bi) >> 1; break;
+        case PredictionCase::A: p = ai; break;
+        case PredictionCase::B: p = bi; break;
+        default: break;
+        }
+        pred[i] = static_cast<float>(p);
+    }
+    return pred;
+}
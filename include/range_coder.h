@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "types.h"
+
+// Binary adaptive range coder in the style of LZMA: 11-bit probabilities that
+// move by 1/32 of the distance after every coded bit.
+class RangeEncoder {
+public:
+    void encode(uint16_t& prob, int bit);
+    void finish();
+    const std::vector<uint8_t>& data() const { return _out; }
+private:
+    uint64_t _low = 0;
+    uint32_t _range = 0xFFFFFFFF;
+    uint8_t _cache = 0;
+    uint64_t _pending = 1;
+    std::vector<uint8_t> _out;
+private:
+    void _shiftLow();
+};
+
+class RangeDecoder {
+public:
+    RangeDecoder(const uint8_t* data, size_t size);
+    int decode(uint16_t& prob);
+private:
+    uint32_t _range = 0xFFFFFFFF;
+    uint32_t _code = 0;
+    const uint8_t* _p;
+    const uint8_t* _end;
+private:
+    uint8_t _next();
+};
+
+// CLERS symbols coded as the bits of the prefix code (C=0, L=110, E=111,
+// R=101, S=100), each bit with its own probability per context. The context
+// is the two previous symbols, which captures runs such as CRCRCR.
+class CLERSModel {
+public:
+    CLERSModel();
+    void encode(RangeEncoder& rc, CLERS s);
+    CLERS decode(RangeDecoder& rc);
+private:
+    static constexpr int CONTEXTS = 25;
+    uint16_t _probs[CONTEXTS][4];
+    int _ctx = 0;
+private:
+    void _update(CLERS s);
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "byte_stream.h"
+
+// Frequencies of a small alphabet, normalized to 1 << PROB_BITS, with the
+// slot table a decoder needs.
+class RANSTable {
+public:
+    static constexpr int PROB_BITS = 12;
+    static constexpr uint32_t TOTAL = 1u << PROB_BITS;
+
+    // Everything decoding one slot needs, in one load.
+    struct Slot {
+        uint16_t symbol;
+        uint16_t freq;
+        uint16_t offset;  // slot - start(symbol)
+        uint16_t unused;
+    };
+
+    explicit RANSTable(const std::vector<uint32_t>& counts);
+    explicit RANSTable(ByteReader& in);
+public:
+    void write(ByteWriter& out) const;
+    uint32_t freq(int s) const { return _freq[s]; }
+    uint32_t start(int s) const { return _start[s]; }
+    const Slot& slot(uint32_t slot) const { return _slots[slot]; }
+    size_t size() const { return _freq.size(); }
+private:
+    std::vector<uint32_t> _freq;
+    std::vector<uint32_t> _start;
+    std::vector<Slot> _slots;
+private:
+    void _finish();
+};
+
+// Static rANS with byte-wise renormalization and two interleaved 32-bit
+// states, so consecutive symbols do not wait on each other when decoding.
+// Symbol i is coded with tables[i % tables.size()] by state i % 2; the
+// encoder works back to front so the decoder reads forward.
+std::vector<uint8_t> ransEncode(
+    const std::vector<uint16_t>& symbols,
+    const std::vector<RANSTable>& tables
+);
+
+class RANSDecoder {
+public:
+    RANSDecoder(const uint8_t* data, size_t size);
+    int decode(const RANSTable& table) {
+        uint32_t x = _x;
+        auto& slot = table.slot(x & (RANSTable::TOTAL - 1));
+        x = slot.freq * (x >> RANSTable::PROB_BITS) + slot.offset;
+        // x >= 2^11 here, so at most two bytes are needed. Done without
+        // branches, which the coded data would make unpredictable.
+        for(int i = 0; i < 2; ++i){
+            bool shift = x < LOW;
+            uint32_t byte = _p < _end ? *_p : 0;
+            x = shift ? (x << 8) | byte : x;
+            _p += shift;
+        }
+        // The other state codes the next symbol.
+        _x = _y;
+        _y = x;
+        return slot.symbol;
+    }
+
+    static constexpr uint32_t LOW = 1u << 23;
+private:
+    uint32_t _x = 0;
+    uint32_t _y = 0;
+    const uint8_t* _p;
+    const uint8_t* _end;
+};
@@ -7,8 +7,12 @@
 #include <sstream>
 #include <string>
 #include <queue>
+#include <span>
 
 #include "types.h"
+#include "thread_pool.h"
+#include "mapped_file.h"
+#include "ovx_format.h"
 
 class ReaderException: public std::exception {
 public:
@@ -21,22 +25,59 @@ private:
     std::string message;
 };
 
+// Binary OVX mapped in place. The spans point into the mapping, so they stay
+// valid for as long as the object lives.
+struct MappedOVX {
+    MappedFile file;
+    std::span<const Vertex> vert;
+    std::vector<std::tuple<std::span<const int>, std::span<const int>, std::vector<Dummy>>> ovx;
+};
+
 class Reader {
 public:
     static std::pair<std::vector<Vertex>, std::vector<Indices>> read_OBJ(
-        const std::string& infile
+        const std::string& infile,
+        ThreadPool* pool = nullptr
     );
 
     static std::pair<std::vector<Vertex>, std::vector<Indices>> read_OFF(
         const std::string& infile
     );
-    static std::pair<std::vector<Vertex>, std::vector<std::tuple<std::vector<int>, std::vector<int>, std::vector<Dummy>>>> read_OVX(
+    // Same as above, but fill vectors the caller keeps, reusing their capacity.
+    static void read_OBJ(
+        const std::string& infile,
+        std::vector<Vertex>& vert,
+        std::vector<Indices>& tri,
+        ThreadPool* pool = nullptr
+    );
+    static void read_OFF(
+        const std::string& infile,
+        std::vector<Vertex>& vert,
+        std::vector<Indices>& tri
+    );
+    static MappedOVX read_OVX(
         const std::string& infile
     );
-    static std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>> read_Compressed(
+    static std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>> read_Compressed(
         const std::string& infile
     );
-    static std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>> read_Compressed_BIN(
+    static std::pair<Quantization, std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>>> read_Compressed_BIN(
         const std::string& infile
     );
+    // Decodes only the given components, in the given order, seeking to them
+    // through the index at the end of the file. index, when given, gets the
+    // whole index, so it is not parsed a second time.
+    static std::pair<Quantization, std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>>> read_Compressed_BIN(
+        const std::string& infile,
+        const std::vector<size_t>& components,
+        std::vector<ComponentInfo>* index = nullptr
+    );
+    // The same for a BCO file already in memory.
+    static std::pair<Quantization, std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>>> read_Compressed_BIN(
+        std::span<const uint8_t> data
+    );
+    static std::pair<Quantization, std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>>> read_Compressed_BIN(
+        std::span<const uint8_t> data,
+        const std::vector<size_t>& components
+    );
 };
\ No newline at end of file
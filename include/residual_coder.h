@@ -0,0 +1,26 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "types.h"
+#include "byte_stream.h"
+
+// Entropy coding of the per-vertex residuals of one component. Every
+// coordinate is split into a bucket, coded with static rANS and one frequency
+// table per axis, and raw bits that are close to uniform anyway. Quantized
+// residuals bucket on the bit length of |r| and keep the sign and the bits
+// below the leading one; floats bucket on sign and exponent and keep the
+// mantissa.
+void encodeResiduals(
+    const std::vector<Vertex>& vertices,
+    bool quantized,
+    ByteWriter& out
+);
+
+void decodeResiduals(
+    ByteReader& in,
+    size_t count,
+    bool quantized,
+    std::deque<Vertex>& vertices
+);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "types.h"
+#include "bco_format.h"
+
+// What --stats reports for one run: stage timings, peak RSS, the counters of
+// every component with their totals and the bytes spent on connectivity and
+// geometry. Written out as a single JSON document.
+class Stats {
+public:
+    explicit Stats(const std::string& mode) : _mode(mode) {}
+public:
+    // Runs f and adds its time to the named stage; a repeated stage adds up.
+    template<typename F>
+    void time(const std::string& stage, F&& f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        add(stage, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    void add(const std::string& stage, double ms);
+    void files(const std::string& infile, size_t infile_bytes, const std::string& outfile, size_t outfile_bytes);
+    // Connectivity and geometry bytes, known when a BCO file was written.
+    void sizes(const BCOSizes& sizes);
+    std::vector<ComponentStats>& components() { return _components; }
+    void write(std::ostream& out) const;
+
+    static size_t peakRSS();
+private:
+    std::string _mode;
+    std::vector<std::pair<std::string, double>> _stages;
+    std::vector<ComponentStats> _components;
+    std::string _infile;
+    std::string _outfile;
+    size_t _infile_bytes = 0;
+    size_t _outfile_bytes = 0;
+    BCOSizes _sizes;
+    bool _has_sizes = false;
+};
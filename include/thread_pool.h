@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool. The calling thread counts as one of the threads and
+// helps draining the queues inside wait(), so ThreadPool(1) runs every task
+// inline, in submission order.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+public:
+    void submit(std::function<void()> task);
+    void wait();
+    int size() const;
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _workers;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    std::atomic<size_t> _queued = 0;
+    size_t _pending = 0;
+    size_t _next = 0;
+    bool _stop = false;
+    std::exception_ptr _error;
+private:
+    void _work(int i);
+    bool _take(int i, std::function<void()>& task);
+    bool _runOne(int i);
+};
+
+// Runs f(i) for every i in order, on the pool when there is one. Must not be
+// called from inside a pool task.
+template<typename F>
+void parallelFor(ThreadPool* pool, const std::vector<size_t>& order, F&& f) {
+    if(!pool || pool->size() == 1){
+        for(auto i : order){
+            f(i);
+        }
+        return;
+    }
+    for(auto i : order){
+        pool->submit([&f, i]{ f(i); });
+    }
+    pool->wait();
+}
+
+template<typename F>
+void parallelFor(ThreadPool* pool, size_t n, F&& f) {
+    std::vector<size_t> order;
+    order.reserve(n);
+    for(size_t i = 0; i < n; ++i){
+        order.push_back(i);
+    }
+    parallelFor(pool, order, std::forward<F>(f));
+}
@@ -1,5 +1,10 @@
 #pragma once
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
 struct File {
     enum class Type {
@@ -16,12 +21,36 @@ enum class CLERS {
     C, L, E, R, S
 };
 
+// How the CLERS string is stored in BCO files.
+enum class CLERSCoder {
+    PREFIX,     // fixed prefix code, C = 1 bit, the others 3 bits
+    ARITHMETIC  // adaptive range coder, see CLERSModel
+};
+
+// How the per-vertex residuals are stored in BCO files.
+enum class VertexCoder {
+    RAW,  // floats as is, or zigzag varints when quantized
+    RANS  // bucketed rANS, see residual_coder.h
+};
+
+// How decompress rebuilds the corner table from the CLERS string.
+enum class ConnectivityDecoder {
+    WRAP_ZIP,        // forward pass that zips free edges as it goes
+    SPIRALE_REVERSI  // backward pass, linear time without zipping
+};
+
 using Indices = std::array<int, 3>;
 
 using Edge = std::array<int, 2>;
 
 using Handle = std::array<int, 2>;
 
+// Handles of a component as delta varints, see handle_stream.h.
+struct HandleStream {
+    size_t count = 0;
+    std::vector<uint8_t> data;
+};
+
 using Vertex = std::array<float,3>;
 inline Vertex operator+(const Vertex& a, const Vertex& b){
     return { a[0] + b[0], a[1] + b[1], a[2] + b[2] };
@@ -36,7 +65,60 @@ inline Vertex operator*(float a, const Vertex& b){
 }
 
 inline Vertex operator/(const Vertex& b, float a){
-    return { a / b[0], a / b[1], a / b[2] };
+    return { b[0] / a, b[1] / a, b[2] / a };
 }
 
-using Dummy = std::pair<int, Vertex>;
\ No newline at end of file
+using Dummy = std::pair<int, Vertex>;
+
+// Grid used by --quant-bits. Positions are stored as round((v - min) / step);
+// bits == 0 means they are stored as plain floats.
+struct Quantization {
+    int bits = 0;
+    Vertex min = {0, 0, 0};
+    float step = 0;
+
+    Vertex toGrid(const Vertex& v) const {
+        float cells = static_cast<float>((1 << bits) - 1);
+        Vertex g;
+        for(int k = 0; k < 3; ++k){
+            g[k] = std::clamp(std::round((v[k] - min[k]) / step), 0.0f, cells);
+        }
+        return g;
+    }
+
+    Vertex fromGrid(const Vertex& g) const {
+        return { min[0] + g[0] * step, min[1] + g[1] * step, min[2] + g[2] * step };
+    }
+};
+
+// The six parallelogram prediction cases, by which of a = N(c), b = P(c) and
+// the opposite vertex d = O(c) are already known.
+enum class PredictionCase {
+    ABD,  // a + b - d
+    AD,   // 2a - d
+    AB,   // (a + b) / 2
+    A,    // a
+    B,    // b
+    NONE  // 0
+};
+constexpr size_t PREDICTION_CASES = 6;
+
+// Counters of one component, reported by --stats. clers is indexed by CLERS,
+// prediction by PredictionCase.
+struct ComponentStats {
+    size_t triangles = 0;
+    size_t vertices = 0;
+    size_t dummies = 0;
+    size_t handles = 0;
+    std::array<size_t, 5> clers{};
+    std::array<size_t, PREDICTION_CASES> prediction{};
+};
+
+// What a component decodes to, dummies left out. Kept in the BCO index so a
+// reader can pick components without decoding them.
+struct ComponentInfo {
+    size_t triangles = 0;
+    size_t vertices = 0;
+    Vertex min = {0, 0, 0};
+    Vertex max = {0, 0, 0};
+};
\ No newline at end of file
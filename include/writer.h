@@ -9,6 +9,9 @@
 #include <iomanip> 
 
 #include "types.h"
+#include "ovx_format.h"
+#include "bco_format.h"
+#include "byte_stream.h"
 
 class WriterException: public std::exception {
     public:
@@ -33,9 +36,13 @@ public:
         const std::string& outfile,
         const std::vector<std::tuple<std::vector<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>>& compressed
     );
-    static void write_Compressed_BIN(
+    static BCOSizes write_Compressed_BIN(
         const std::string& outfile,
-        const std::vector<std::tuple<std::vector<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>>& compressed
+        const std::vector<std::tuple<std::vector<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>>& compressed,
+        const std::vector<ComponentInfo>& info,
+        const Quantization& quant = {},
+        CLERSCoder clers_coder = CLERSCoder::PREFIX,
+        VertexCoder vertex_coder = VertexCoder::RAW
     );
     static void write_OBJ(
         const std::string& outfile,
@@ -47,4 +54,50 @@ public:
         const std::vector<Vertex>& vert,
         const std::vector<Indices>& tri
     );
-};
\ No newline at end of file
+};
+
+// Writes a BCO file, or appends it to a byte vector, one component at a time.
+// The header goes out first, so the component count has to be known up
+// front; every component is encoded and flushed as soon as it is appended.
+// finish() writes the index.
+class BCOStreamWriter {
+public:
+    BCOStreamWriter(
+        const std::string& outfile,
+        size_t components,
+        const Quantization& quant = {},
+        CLERSCoder clers_coder = CLERSCoder::PREFIX,
+        VertexCoder vertex_coder = VertexCoder::RAW
+    );
+    BCOStreamWriter(
+        std::vector<uint8_t>& out,
+        size_t components,
+        const Quantization& quant = {},
+        CLERSCoder clers_coder = CLERSCoder::PREFIX,
+        VertexCoder vertex_coder = VertexCoder::RAW
+    );
+public:
+    void append(
+        const std::vector<Vertex>& vertices,
+        const std::pair<int, std::vector<CLERS>>& clers,
+        const std::vector<Handle>& handles,
+        const std::vector<Dummy>& dummy,
+        const ComponentInfo& info
+    );
+    BCOSizes finish();
+private:
+    std::string _outfile;
+    std::ofstream _out;
+    std::vector<uint8_t>* _target = nullptr;
+    ByteWriter _buffer;
+    BCOSizes _sizes;
+    std::vector<BCOFormat::IndexEntry> _index;
+    size_t _components;
+    size_t _appended = 0;
+    bool _quantized;
+    bool _arithmetic_clers;
+    bool _rans_vertices;
+private:
+    void _start(const Quantization& quant);
+    void _flush();
+};
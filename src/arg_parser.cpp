@@ -1,17 +1,23 @@
 #include "arg_parser.h"
 
+#include <sstream>
+
 
 void printUsage(const std::string& programName) {
-    std::cerr << "Usage: " << programName << " <compress|decompress|ovx> "
-              << "<input_file> <output_file> ";
+    std::cerr << "Usage: " << programName << " <compress|decompress|ovx|batch> "
+              << "<input_file> <output_file> [--threads N] [--quant-bits N] [--clers-coder prefix|arith] [--vertex-coder raw|rans] [--decoder wrapzip|reversi] [--stream] [--component i[,j...]] [--stats] ";
 }
 void printUsageCompress(const std::string& programName) {
     std::cerr << "Usage: " << programName << " compress "
-                << "<input_file.[obj|off|ovx]> <output_file.[bco|co]> ";  
+                << "<input_file.[obj|off|ovx]> <output_file.[bco|co]> [--threads N] [--quant-bits N] [--clers-coder prefix|arith] [--vertex-coder raw|rans] [--stream] [--stats] ";  
 }
 void printUsageDecompress(const std::string& programName) {
     std::cerr << "Usage: " << programName << " decompress "
-                << "<input_file.[bco|co]> <output_file.[obj|off|ovx]> ";  
+                << "<input_file.[bco|co]> <output_file.[obj|off|ovx]> [--threads N] [--decoder wrapzip|reversi] [--component i[,j...]] [--stats] ";  
+}
+void printUsageBatch(const std::string& programName) {
+    std::cerr << "Usage: " << programName << " batch "
+                << "<manifest|directory|\"pattern\"> <output_directory> [--threads N] [--quant-bits N] [--clers-coder prefix|arith] [--vertex-coder raw|rans] ";
 }
 void printUsageOVX(const std::string& programName) {
     std::cerr << "Usage: " << programName << " ovx "
@@ -44,6 +50,95 @@ Args parseArgs(int argc, char* argv[]) {
     args.infile_type = findFileType(args.infile);
     args.outfile_type = findFileType(args.outfile);
 
+    for (int i = 4; i < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--threads" && i + 1 < argc) {
+            try {
+                args.threads = std::stoi(argv[++i]);
+            }
+            catch (const std::exception&) {
+                printUsage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            if (args.threads < 0) {
+                printUsage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (opt == "--quant-bits" && i + 1 < argc) {
+            try {
+                args.quant_bits = std::stoi(argv[++i]);
+            }
+            catch (const std::exception&) {
+                printUsage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            // Grid coordinates and residuals have to stay exact in a float.
+            if (args.quant_bits < 1 || args.quant_bits > 22) {
+                std::cerr << "--quant-bits must be between 1 and 22\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (opt == "--clers-coder" && i + 1 < argc) {
+            std::string coder = argv[++i];
+            if (coder == "prefix") args.clers_coder = CLERSCoder::PREFIX;
+            else if (coder == "arith") args.clers_coder = CLERSCoder::ARITHMETIC;
+            else {
+                printUsage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (opt == "--vertex-coder" && i + 1 < argc) {
+            std::string coder = argv[++i];
+            if (coder == "raw") args.vertex_coder = VertexCoder::RAW;
+            else if (coder == "rans") args.vertex_coder = VertexCoder::RANS;
+            else {
+                printUsage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (opt == "--stream") {
+            args.stream = true;
+        }
+        else if (opt == "--stats") {
+            args.stats = true;
+        }
+        else if (opt == "--component" && i + 1 < argc) {
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                size_t pos = 0;
+                try {
+                    args.components.push_back(std::stoull(item, &pos));
+                }
+                catch (const std::exception&) {
+                    pos = 0;
+                }
+                if (pos == 0 || pos != item.size() || item[0] == '-') {
+                    printUsage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+            }
+            if (args.components.empty()) {
+                printUsage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (opt == "--decoder" && i + 1 < argc) {
+            std::string decoder = argv[++i];
+            if (decoder == "wrapzip") args.decoder = ConnectivityDecoder::WRAP_ZIP;
+            else if (decoder == "reversi") args.decoder = ConnectivityDecoder::SPIRALE_REVERSI;
+            else {
+                printUsage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else {
+            printUsage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
     if (args.mode == "compress") {
         if((args.infile_type != File::Type::OBJ && args.infile_type != File::Type::OFF && args.infile_type != File::Type::OVX) ||
             (args.outfile_type != File::Type::BCO && args.outfile_type != File::Type::CO)
@@ -51,14 +146,54 @@ Args parseArgs(int argc, char* argv[]) {
             printUsageCompress(argv[0]);
             exit(EXIT_FAILURE);
         }
+        if (args.quant_bits > 0 && args.outfile_type != File::Type::BCO) {
+            std::cerr << "--quant-bits requires a .bco output\n";
+            exit(EXIT_FAILURE);
+        }
+        if (args.clers_coder != CLERSCoder::PREFIX && args.outfile_type != File::Type::BCO) {
+            std::cerr << "--clers-coder requires a .bco output\n";
+            exit(EXIT_FAILURE);
+        }
+        if (args.vertex_coder != VertexCoder::RAW && args.outfile_type != File::Type::BCO) {
+            std::cerr << "--vertex-coder requires a .bco output\n";
+            exit(EXIT_FAILURE);
+        }
+        if (args.stream && args.outfile_type != File::Type::BCO) {
+            std::cerr << "--stream requires a .bco output\n";
+            exit(EXIT_FAILURE);
+        }
+        if (args.decoder != ConnectivityDecoder::WRAP_ZIP) {
+            std::cerr << "--decoder only applies to decompress\n";
+            exit(EXIT_FAILURE);
+        }
+        if (!args.components.empty()) {
+            std::cerr << "--component only applies to decompress\n";
+            exit(EXIT_FAILURE);
+        }
     }
     else if(args.mode == "decompress"){
+        if (args.stream) {
+            std::cerr << "--stream only applies to compress\n";
+            exit(EXIT_FAILURE);
+        }
         if((args.infile_type != File::Type::BCO && args.infile_type != File::Type::CO) || (args.outfile_type != File::Type::OVX &&
             args.outfile_type != File::Type::OBJ && args.outfile_type != File::Type::OFF)
         ){
             printUsageDecompress(argv[0]);
             exit(EXIT_FAILURE);
         }
+        if (!args.components.empty() && args.infile_type != File::Type::BCO) {
+            std::cerr << "--component requires a .bco input\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+    else if(args.mode == "batch"){
+        // Inputs and outputs are listed per file; the BCO-only options are
+        // checked against each output when it is compressed.
+        if (args.stream || args.stats || args.decoder != ConnectivityDecoder::WRAP_ZIP || !args.components.empty()) {
+            printUsageBatch(argv[0]);
+            exit(EXIT_FAILURE);
+        }
     }
     else if(args.mode == "ovx"){
         if((args.infile_type != File::Type::OBJ && args.infile_type != File::Type::OFF) ||
@@ -0,0 +1,109 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <fstream>
+
+#include "arg_parser.h"
+#include "reader.h"
+
+namespace fs = std::filesystem;
+
+#pragma region HELPERS
+
+// Shell-style match of * and ? against a whole file name.
+bool matchGlob(const std::string& pattern, const std::string& name) {
+    size_t p = 0, n = 0;
+    size_t star = std::string::npos, resume = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+            ++p;
+            ++n;
+        }
+        else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = n;
+        }
+        else if (star != std::string::npos) {
+            p = star + 1;
+            n = ++resume;
+        }
+        else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+bool isMesh(File::Type type) {
+    return type == File::Type::OBJ || type == File::Type::OFF || type == File::Type::OVX;
+}
+
+BatchJob makeJob(const fs::path& infile, const fs::path& outfile, const fs::path& outdir) {
+    fs::path out = outfile.empty() ? outdir / infile.stem().concat(".bco") : outfile;
+    if (out.is_relative() && !outfile.empty()) out = outdir / out;
+
+    BatchJob job;
+    job.infile = infile.string();
+    job.outfile = out.lexically_normal().string();
+    job.infile_type = findFileType(job.infile);
+    job.outfile_type = findFileType(job.outfile);
+    return job;
+}
+
+std::vector<BatchJob> listDirectory(const fs::path& dir, const std::string& pattern, const fs::path& outdir) {
+    std::error_code ec;
+    fs::directory_iterator it(dir.empty() ? fs::path(".") : dir, ec);
+    if (ec) throw ReaderException(std::format("Cannot list directory {}!", dir.string()));
+
+    std::vector<fs::path> files;
+    for (auto& entry : it) {
+        if (!entry.is_regular_file(ec)) continue;
+        auto name = entry.path().filename().string();
+        if (pattern.empty() ? isMesh(findFileType(name)) : matchGlob(pattern, name)) {
+            files.push_back(dir.empty() ? fs::path(name) : entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    std::vector<BatchJob> jobs;
+    for (auto& f : files) {
+        jobs.push_back(makeJob(f, {}, outdir));
+    }
+    return jobs;
+}
+
+std::vector<BatchJob> readManifest(const fs::path& manifest, const fs::path& outdir) {
+    std::ifstream in(manifest);
+    if (!in) throw ReaderException(std::format("Cannot open file {}!", manifest.string()));
+
+    std::vector<BatchJob> jobs;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        auto tab = line.find('\t');
+        fs::path infile = line.substr(0, tab);
+        fs::path outfile = tab == std::string::npos ? std::string() : line.substr(tab + 1);
+        if (infile.is_relative()) infile = manifest.parent_path() / infile;
+        jobs.push_back(makeJob(infile.lexically_normal(), outfile, outdir));
+    }
+    return jobs;
+}
+
+#pragma endregion
+
+std::vector<BatchJob> listBatch(const std::string& source, const std::string& outdir) {
+    fs::path path(source);
+    auto name = path.filename().string();
+    if (name.find_first_of("*?") != std::string::npos) {
+        return listDirectory(path.parent_path(), name, outdir);
+    }
+    if (fs::is_directory(path)) {
+        return listDirectory(path, "", outdir);
+    }
+    return readManifest(path, outdir);
+}
@@ -1,10 +1,33 @@
 #include "compressor.h"
+#include "prediction.h"
+
+#include <algorithm>
 
 Compressor::Compressor(
-    const std::vector<Vertex> &vert,
-    const std::vector<int> &V, 
-    const std::vector<int> &O
-) : _G(vert), _V(V), _O(O), _M(vert.size(), 0), _U(V.size() / 3, 0), _D(vert.size(), {0, 0, 0}) { }
+    std::span<const Vertex> vert,
+    std::span<const int> V,
+    std::span<const int> O,
+    const Quantization& quant
+) : _U(V.size() / 3, 0), _O(O), _quant(quant), _quantized(quant.bits > 0) {
+    _L.assign(V.begin(), V.end());
+    std::sort(_L.begin(), _L.end());
+    _L.erase(std::unique(_L.begin(), _L.end()), _L.end());
+
+    _V.resize(V.size());
+    for(size_t i = 0; i < V.size(); ++i){
+        _V[i] = std::lower_bound(_L.begin(), _L.end(), V[i]) - _L.begin();
+    }
+
+    _G.resize(_L.size());
+    for(size_t i = 0; i < _L.size(); ++i){
+        // Quantized while copying, so no grid of the whole mesh is needed.
+        _G[i] = _quantized ? quant.toGrid(vert[_L[i]]) : vert[_L[i]];
+    }
+
+    _M.resize(_L.size(), 0);
+    _D.resize(_L.size(), {0, 0, 0});
+    _S.resize(_L.size(), -1);
+}
 
 void Compressor::compress(
     int c,
@@ -14,6 +37,12 @@ void Compressor::compress(
     std::vector<Dummy>& dummy
 ) {
     _reset();
+    for(int i = 0; i < static_cast<int>(dummy.size()); ++i){
+        auto it = std::lower_bound(_L.begin(), _L.end(), dummy[i].first);
+        if(it != _L.end() && *it == dummy[i].first){
+            _S[it - _L.begin()] = i;
+        }
+    }
     c = P(c);
 
     _encodeDelta(N(c), vertices, dummy);
@@ -42,6 +71,26 @@ void Compressor::compress(
     _compress(_O[P(a)], vertices, clers, handles, dummy);
 }
 
+ComponentInfo Compressor::info() const {
+    ComponentInfo info;
+    info.min = { INFINITY, INFINITY, INFINITY };
+    info.max = { -INFINITY, -INFINITY, -INFINITY };
+    // _D holds the positions as the decoder rebuilds them, not the input.
+    for(size_t i = 0; i < _D.size(); ++i){
+        if(_S[i] >= 0) continue;
+        Vertex v = _quantized ? _quant.fromGrid(_D[i]) : _D[i];
+        for(int k = 0; k < 3; ++k){
+            info.min[k] = std::min(info.min[k], v[k]);
+            info.max[k] = std::max(info.max[k], v[k]);
+        }
+        ++info.vertices;
+    }
+    for(size_t c = 0; c < _V.size(); c += 3){
+        if(_S[_V[c]] < 0 && _S[_V[c + 1]] < 0 && _S[_V[c + 2]] < 0) ++info.triangles;
+    }
+    return info;
+}
+
 void Compressor::_compress(
     int c,
     std::vector<Vertex>& vertices,
@@ -49,6 +98,8 @@ void Compressor::_compress(
     std::vector<Handle>& handles,
     std::vector<Dummy>& dummy
 ) {
+    // Every S pushes the corner where its left branch continues; E pops it.
+    _stack.clear();
     for(;;){
         _U[T(c)] = 1;
         ++_T;
@@ -71,7 +122,15 @@ void Compressor::_compress(
             if(_U[T(R(_O, c))] > 0) {
                 if(_U[T(L(_O, c))] > 0) {
                     clers.second.push_back(CLERS::E);
-                    return;
+
+                    // Resume the innermost S whose left branch is still unvisited.
+                    do {
+                        if(_stack.empty()) {
+                            return;
+                        }
+                        c = _stack.back();
+                        _stack.pop_back();
+                    } while(_U[T(c)] > 0);
                 }
                 else {
                     clers.second.push_back(CLERS::R);
@@ -86,14 +145,9 @@ void Compressor::_compress(
                 else {
                     clers.second.push_back(CLERS::S);
                     _U[T(c)] = _T * 3 + 2;
-                    
-                    _compress(R(_O, c), vertices, clers, handles, dummy);
 
-                    c = L(_O, c);
-
-                    if(_U[T(c)] > 0) {
-                        return;
-                    }
+                    _stack.push_back(L(_O, c));
+                    c = R(_O, c);
                 }
             }
         }
@@ -105,38 +159,17 @@ void Compressor::_encodeDelta(
     std::vector<Vertex>& vertices,
     std::vector<Dummy>& dummy
 ) {
-    for(auto& [i, v] : dummy){
-        if(v == _G[_V[c]]){
-            i = vertices.size();
-        }
+    if(_S[_V[c]] >= 0){
+        dummy[_S[_V[c]]].first = vertices.size();
     }
 
-    Vertex pred, delta;
-    if (_M[_V[_O[c]]] > 0 && _M[_V[P(c)]] > 0) {
-        // Case 1: a, b, d known (a + b - d)
-        pred = _D[_V[N(c)]] + _D[_V[P(c)]] - _D[_V[_O[c]]];
-        delta = _G[_V[c]] - pred;
-    } else if (_M[_V[_O[c]]] > 0) {
-        // Case 2: a and d known (2a - d)
-        pred = 2.0f * _D[_V[N(c)]] - _D[_V[_O[c]]];
-        delta = _G[_V[c]] - pred;
-    } else if (_M[_V[N(c)]] > 0 && _M[_V[P(c)]] > 0) {
-        // Case 3: a and b known ((a + b)/2)
-        pred = (_D[_V[N(c)]] + _D[_V[P(c)]]) / 2.0f;
-        delta = _G[_V[c]] - pred;
-    } else if (_M[_V[N(c)]] > 0) {
-        // Case 4: a known (a)
-        pred = _D[_V[N(c)]];
-        delta = _G[_V[c]] - pred;
-    } else if (_M[_V[P(c)]] > 0) {
-        // Case 5: b known (b)
-        pred = _D[_V[P(c)]];
-        delta = _G[_V[c]] - pred;
-    } else {
-        // Case 6: nothing known (0)
-        pred = Vertex({0, 0, 0});
-        delta = _G[_V[c]] - pred;
-    }
+    auto k = predictionCase(_M[_V[N(c)]] > 0, _M[_V[P(c)]] > 0, _M[_V[_O[c]]] > 0);
+    ++_cases[static_cast<size_t>(k)];
+    auto& A = _D[_V[N(c)]];
+    auto& B = _D[_V[P(c)]];
+    auto& D = _D[_V[_O[c]]];
+    Vertex pred = _quantized ? predictQuantized(k, A, B, D) : predict(k, A, B, D);
+    Vertex delta = _G[_V[c]] - pred;
 
     _D[_V[c]] = delta + pred;
     vertices.push_back(delta);
@@ -146,6 +179,8 @@ void Compressor::_reset() {
     std::fill(_M.begin(), _M.end(), 0);
     std::fill(_U.begin(), _U.end(), 0);
     std::fill(_D.begin(), _D.end(), Vertex({0, 0, 0}));
+    std::fill(_S.begin(), _S.end(), -1);
+    _cases.fill(0);
 
     _T = 0;
 }
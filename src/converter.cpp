@@ -1,127 +1,209 @@
 #include "converter.h"
 
 #include <algorithm>
-#include <set>
-#include <map>
-#include <unordered_set>
-#include <unordered_map>
-#include <stack>
+#include <cmath>
+#include <atomic>
+#include <bit>
+#include <cstdint>
 
 #pragma region HELPERS
 
-std::vector<std::vector<Indices>> splitIntoComponents(
-    int vert_size,
-    const std::vector<Indices>& tri
+int findRoot(
+    std::vector<std::atomic<int>>& parent,
+    int x
 ) {
-    std::vector<std::unordered_set<int>> adj(vert_size);
-    for (const auto& t : tri) {
-        adj[t[0]].insert({t[1], t[2]});
-        adj[t[1]].insert({t[0], t[2]});
-        adj[t[2]].insert({t[1], t[0]});
-    }
-    
-    std::vector<int> component(vert_size, -1);
-    int comp_id = 0;
-    for (int i = 0; i < vert_size; ++i) {
-        if (component[i] == -1) {
-            std::stack<int> st;
-            st.push(i);
-            component[i] = comp_id;
-            while (!st.empty()) {
-                int v = st.top();
-                st.pop();
-                for (int neighbor : adj[v]) {
-                    if (component[neighbor] == -1) {
-                        component[neighbor] = comp_id;
-                        st.push(neighbor);
-                    }
-                }
-            }
-            comp_id++;
+    for(;;){
+        int p = parent[x].load(std::memory_order_relaxed);
+        if(p == x){
+            return x;
+        }
+        int gp = parent[p].load(std::memory_order_relaxed);
+        if(gp != p){
+            parent[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
         }
+        x = gp;
     }
+}
 
-    std::vector<std::vector<Indices>> result(comp_id);
-    for (const auto& t : tri) {
-        result[component[t[0]]].push_back(t);
+// Roots are always linked under the smaller one, so every root is the
+// smallest vertex of its set. The CAS makes concurrent unions safe.
+void unite(
+    std::vector<std::atomic<int>>& parent,
+    int a,
+    int b
+) {
+    for(;;){
+        a = findRoot(parent, a);
+        b = findRoot(parent, b);
+        if(a == b){
+            return;
+        }
+        if(a < b){
+            std::swap(a, b);
+        }
+        int expected = a;
+        if(parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)){
+            return;
+        }
     }
+}
 
-    return result;
-};
-
-std::vector<Edge> findBoundaryEdges(
-    const std::vector<Indices>& tri
+// Returns the triangles grouped by component, in their original order, and
+// the offset of every component in that array. Components are numbered by
+// their smallest vertex, as the old DFS over vertices did.
+std::pair<std::vector<Indices>, std::vector<size_t>> splitIntoComponents(
+    int vert_size,
+    const std::vector<Indices>& tri,
+    ThreadPool* pool
 ) {
-    std::set<Edge> edges;
-    for(const auto& t : tri){
-        for(int i = 0; i < 3; ++i){
-            edges.insert({t[i], t[(i + 1) % 3]});
+    size_t chunks = pool ? std::min<size_t>(pool->size() * 4, std::max<size_t>(tri.size() >> 16, 1)) : 1;
+    auto range = [&](size_t k, size_t n){
+        return std::make_pair(k * n / chunks, (k + 1) * n / chunks);
+    };
+
+    std::vector<std::atomic<int>> parent(vert_size);
+    parallelFor(chunks > 1 ? pool : nullptr, chunks, [&](size_t k){
+        auto [begin, end] = range(k, vert_size);
+        for(size_t i = begin; i < end; ++i){
+            parent[i].store(i, std::memory_order_relaxed);
         }
-    }
+    });
+    parallelFor(chunks > 1 ? pool : nullptr, chunks, [&](size_t k){
+        auto [begin, end] = range(k, tri.size());
+        for(size_t i = begin; i < end; ++i){
+            unite(parent, tri[i][0], tri[i][1]);
+            unite(parent, tri[i][0], tri[i][2]);
+        }
+    });
 
-    std::vector<Edge> result;
-    for(const auto& e : edges){
-        if(edges.find({e[1], e[0]}) == edges.end()){
-            result.push_back(e);
+    std::vector<int> component(tri.size());
+    parallelFor(chunks > 1 ? pool : nullptr, chunks, [&](size_t k){
+        auto [begin, end] = range(k, tri.size());
+        for(size_t i = begin; i < end; ++i){
+            component[i] = findRoot(parent, tri[i][0]);
+        }
+    });
+
+    // Reuse the vertex array as root -> component id.
+    std::vector<int> comp_id(vert_size, -1);
+    for(int c : component){
+        comp_id[c] = 0;
+    }
+    int comp_size = 0;
+    for(int i = 0; i < vert_size; ++i){
+        if(comp_id[i] == 0){
+            comp_id[i] = ++comp_size;
         }
     }
 
-    return result;
-};
+    std::vector<size_t> offsets(comp_size + 1, 0);
+    for(auto& c : component){
+        c = comp_id[c] - 1;
+        ++offsets[c + 1];
+    }
+    for(int k = 0; k < comp_size; ++k){
+        offsets[k + 1] += offsets[k];
+    }
 
-void fill_holes(
-    std::vector<Vertex>& vert, 
-    std::vector<Indices>& tri, 
-    const std::vector<Edge>& edges,
-    std::vector<Dummy>& dummy
-) {
-    std::unordered_map<int, std::vector<int>> adj;
-    for (const auto& e : edges) {
-        adj[e[0]].push_back(e[1]);
+    std::vector<Indices> result(tri.size());
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < tri.size(); ++i){
+        result[fill[component[i]]++] = tri[i];
     }
 
-    std::unordered_set<int> visited;
-    int vertex_i = vert.size();
+    return {std::move(result), std::move(offsets)};
+};
+
+// Walks the unmatched corners of the opposite table. The boundary edge of
+// corner c runs from V[N(c)] to V[P(c)]; the next one is found by turning
+// around V[P(c)] until an unmatched corner comes up. At vertices where
+// several holes touch, that turn stays inside one wedge of triangles and
+// would join the holes, so there each incoming edge is handed to the next
+// wedge's outgoing edge instead.
+std::vector<std::vector<int>> findBoundaryLoops(
+    const std::vector<int>& V,
+    const std::vector<int>& O
+) {
+    auto next = [](int c){ return 3 * (c / 3) + (c + 1) % 3; };
 
-    for (const auto& entry : adj) {
-        int start = entry.first;
-        if (visited.find(start) != visited.end()) {
+    std::vector<int> succ(O.size(), -1);
+    std::vector<int> pred(O.size(), -1);
+    std::vector<std::pair<int, int>> starts;
+    for(int c = 0; c < static_cast<int>(O.size()); ++c){
+        if(O[c] != -1){
             continue;
         }
 
-        int current = start;
-        int prev = -1;
-        std::vector<int> loop;
-
-        while (true) {
-            loop.push_back(current);
-            visited.insert(current);
-
-            std::vector<int> neighbors;
-            for (int n : adj[current]) {
-                if (n != prev) {
-                    neighbors.push_back(n);
-                }
-            }
+        int x = next(c);
+        for(int steps = 0; O[x] >= 0 && steps < static_cast<int>(O.size()); ++steps){
+            x = next(O[x]);
+        }
+        if(O[x] == -1){
+            succ[c] = x;
+            pred[x] = c;
+        }
+        starts.push_back({V[next(c)], c});
+    }
 
-            if (neighbors.empty()) {
-                break;
+    std::sort(starts.begin(), starts.end());
+    for(size_t i = 0; i < starts.size();){
+        size_t j = i + 1;
+        while(j < starts.size() && starts[j].first == starts[i].first){
+            ++j;
+        }
+        for(size_t k = i; j - i > 1 && k < j; ++k){
+            int in = pred[starts[k].second];
+            if(in >= 0){
+                succ[in] = starts[k + 1 < j ? k + 1 : i].second;
             }
+        }
+        i = j;
+    }
 
-            int next_node = neighbors[0];
-            if (next_node == loop[0] && loop.size() > 1) {
-                break;
-            }
+    std::vector<std::vector<int>> loops;
+    std::vector<char> visited(O.size(), 0);
+    for(auto [_, start] : starts){
+        if(visited[start]){
+            continue;
+        }
 
-            prev = current;
-            current = next_node;
+        std::vector<int> loop;
+        int c = start;
+        do {
+            visited[c] = 1;
+            loop.push_back(c);
+            c = succ[c];
+        } while(c >= 0 && c != start && !visited[c]);
+
+        if(c == start){
+            loops.push_back(std::move(loop));
         }
+    }
+
+    return loops;
+};
 
-        if (loop.size() < 3) {
+// Closes every loop of at least three edges with a fan around its centroid.
+// The fan's opposites are known from the loop, so they are set directly.
+void fill_holes(
+    std::vector<Vertex>& vert, 
+    std::vector<int>& V, 
+    std::vector<int>& O, 
+    const std::vector<std::vector<int>>& loops,
+    std::vector<Dummy>& dummy
+) {
+    auto next = [](int c){ return 3 * (c / 3) + (c + 1) % 3; };
+
+    for (const auto& corners : loops) {
+        int size = corners.size();
+        if (size < 3) {
             continue;
         }
 
-        reverse(loop.begin(), loop.end());
+        std::vector<int> loop(size);
+        for (int i = 0; i < size; ++i) {
+            loop[i] = V[next(corners[size - 1 - i])];
+        }
 
         std::array<float, 3> centroid = {0.0f, 0.0f, 0.0f};
         for (int v : loop) {
@@ -134,84 +216,286 @@ void fill_holes(
         centroid[1] *= inv_size;
         centroid[2] *= inv_size;
 
+        int vertex_i = vert.size();
         vert.push_back(centroid);
         dummy.push_back({vertex_i, centroid});
 
-        for (size_t i = 0; i < loop.size(); ++i) {
-            tri.push_back({vertex_i, loop[i], loop[(i + 1) % loop.size()]});
+        int first = V.size();
+        V.resize(first + 3 * size);
+        O.resize(first + 3 * size);
+        for (int i = 0; i < size; ++i) {
+            int f = first + 3 * i;
+            int g = first + 3 * ((i + 1) % size);
+            V[f] = vertex_i;
+            V[f + 1] = loop[i];
+            V[f + 2] = loop[(i + 1) % size];
+
+            int b = corners[(2 * size - 2 - i) % size];
+            O[f] = b;
+            O[b] = f;
+            O[f + 1] = g + 2;
+            O[g + 2] = f + 1;
         }
-
-        vertex_i++;
     }
 };
+
+struct EdgeCorner {
+    uint64_t key;
+    int corner;
+};
+
+// Stable LSD radix sort on key, 11 bits per pass. Passes whose digit is the
+// same for every entry are skipped. With a pool, every pass is split into
+// chunks that histogram and scatter in parallel.
+void radixSort(
+    std::vector<EdgeCorner>& items,
+    int key_bits,
+    ThreadPool* pool
+) {
+    constexpr int BITS = 11;
+    constexpr int BUCKETS = 1 << BITS;
+
+    size_t n = items.size();
+    size_t chunks = pool ? std::min<size_t>(pool->size() * 4, std::max<size_t>(n >> 16, 1)) : 1;
+    size_t chunk_size = (n + chunks - 1) / chunks;
+
+    std::vector<EdgeCorner> tmp(n);
+    std::vector<size_t> hist(chunks * BUCKETS);
+    for(int shift = 0; shift < key_bits; shift += BITS){
+        std::fill(hist.begin(), hist.end(), 0);
+        parallelFor(chunks > 1 ? pool : nullptr, chunks, [&](size_t k){
+            size_t* h = &hist[k * BUCKETS];
+            size_t end = std::min(n, (k + 1) * chunk_size);
+            for(size_t i = k * chunk_size; i < end; ++i){
+                ++h[(items[i].key >> shift) & (BUCKETS - 1)];
+            }
+        });
+
+        bool single = false;
+        for(size_t d = 0; d < BUCKETS && !single; ++d){
+            size_t total = 0;
+            for(size_t k = 0; k < chunks; ++k){
+                total += hist[k * BUCKETS + d];
+            }
+            single = total == n;
+        }
+        if(single){
+            continue;
+        }
+
+        size_t offset = 0;
+        for(size_t d = 0; d < BUCKETS; ++d){
+            for(size_t k = 0; k < chunks; ++k){
+                size_t count = hist[k * BUCKETS + d];
+                hist[k * BUCKETS + d] = offset;
+                offset += count;
+            }
+        }
+
+        parallelFor(chunks > 1 ? pool : nullptr, chunks, [&](size_t k){
+            size_t* h = &hist[k * BUCKETS];
+            size_t end = std::min(n, (k + 1) * chunk_size);
+            for(size_t i = k * chunk_size; i < end; ++i){
+                tmp[h[(items[i].key >> shift) & (BUCKETS - 1)]++] = items[i];
+            }
+        });
+        items.swap(tmp);
+    }
+}
+
+// Pairs up the corners opposite to the same undirected edge. On non-manifold
+// edges the first corner is paired with every later one and keeps the last.
+void buildOpposite(
+    const std::vector<int>& V,
+    std::vector<int>& O,
+    ThreadPool* pool
+) {
+    if(V.empty()){
+        return;
+    }
+
+    auto [lo, hi] = std::minmax_element(V.begin(), V.end());
+    int base = *lo;
+    int bits = std::bit_width(static_cast<uint32_t>(*hi - base));
+
+    std::vector<EdgeCorner> items(V.size());
+    for(int c = 0; c < static_cast<int>(V.size()); ++c){
+        int t = c - c % 3;
+        auto mm = std::minmax(V[t + (c + 1) % 3], V[t + (c + 2) % 3]);
+        items[c] = {(uint64_t(mm.first - base) << bits) | uint64_t(mm.second - base), c};
+    }
+
+    radixSort(items, 2 * bits, pool);
+
+    for(size_t i = 0; i < items.size();){
+        size_t j = i + 1;
+        for(; j < items.size() && items[j].key == items[i].key; ++j){
+            O[items[j].corner] = items[i].corner;
+            O[items[i].corner] = items[j].corner;
+        }
+        i = j;
+    }
+}
 #pragma endregion
 
 std::vector<std::tuple<std::vector<int>, std::vector<int>, std::vector<Dummy>>> Converter::toOVX(
     std::vector<Vertex>& vert, 
-    std::vector<Indices>& tri
+    std::vector<Indices>& tri,
+    ThreadPool* pool
 ) {
     std::vector<std::tuple<std::vector<int>, std::vector<int>, std::vector<Dummy>>> result;
+    toOVX(vert, tri, result, pool);
+    return result;
+}
 
-    auto components = splitIntoComponents(vert.size(), tri);
-    for(auto& c_tri : components){
-        auto& [V, O, dummy] = result.emplace_back();
-        
-        auto edges = findBoundaryEdges(c_tri);
-        fill_holes(vert, c_tri, edges, dummy);
-        
-        int tri_size = c_tri.size();
-        for(const auto& t : c_tri){
-            V.insert(V.end(), t.begin(), t.end());
-        }
-        O.insert(O.begin(), 3 * tri_size, -1);
-
-        std::map<Edge, int> edge_dict;
-        for (int t_idx = 0; t_idx < tri_size; ++t_idx) {
-            const auto& tri = c_tri[t_idx];
-            for (int i = 0; i < 3; ++i) {
-                int c = 3 * t_idx + i;
-                auto mm = std::minmax(tri[(i + 1) % 3], tri[(i - 1 + 3) % 3]);
-                Edge edge({mm.first, mm.second});
-    
-                auto it = edge_dict.find(edge);
-                if (it != edge_dict.end()) {
-                    int c2 = it->second;
-                    O[c] = c2;
-                    O[c2] = c;
-                } else {
-                    edge_dict[edge] = c;
-                }
-            }
+void Converter::toOVX(
+    std::vector<Vertex>& vert,
+    std::vector<Indices>& tri,
+    std::vector<std::tuple<std::vector<int>, std::vector<int>, std::vector<Dummy>>>& result,
+    ThreadPool* pool
+) {
+    auto [c_tri, offsets] = splitIntoComponents(vert.size(), tri, pool);
+    result.resize(offsets.size() - 1);
+    parallelFor(pool, result.size(), [&](size_t k){
+        auto& [V, O, dummy] = result[k];
+        V.clear();
+        dummy.clear();
+        V.reserve(3 * (offsets[k + 1] - offsets[k]));
+        for(size_t i = offsets[k]; i < offsets[k + 1]; ++i){
+            V.insert(V.end(), c_tri[i].begin(), c_tri[i].end());
+        }
+        O.assign(V.size(), -1);
+    });
+
+    // Big components sort their edges on the whole pool, the others are
+    // spread over it one component per task.
+    std::vector<std::vector<std::vector<int>>> loops(result.size());
+    std::vector<size_t> small;
+    for(size_t k = 0; k < result.size(); ++k){
+        auto& [V, O, _] = result[k];
+        if(pool && V.size() >= (1 << 20)){
+            buildOpposite(V, O, pool);
+            loops[k] = findBoundaryLoops(V, O);
+        }
+        else{
+            small.push_back(k);
         }
     }
-    
-    return result;
+    parallelFor(pool, small, [&](size_t k){
+        auto& [V, O, _] = result[k];
+        buildOpposite(V, O, nullptr);
+        loops[k] = findBoundaryLoops(V, O);
+    });
+
+    // Dummy vertices are numbered in component order, so this part stays serial.
+    for(size_t k = 0; k < result.size(); ++k){
+        auto& [V, O, dummy] = result[k];
+        fill_holes(vert, V, O, loops[k], dummy);
+    }
 }
 
-std::pair<std::vector<Vertex>, std::vector<Indices>> Converter::fromOVX(
-    const std::vector<std::tuple<std::vector<Vertex>, std::vector<int>, std::vector<int>, std::vector<Dummy>>> &ovx
+std::pair<std::vector<Indices>, std::vector<size_t>> Converter::splitIntoComponents(
+    int vert_size,
+    const std::vector<Indices>& tri,
+    ThreadPool* pool
+) {
+    return ::splitIntoComponents(vert_size, tri, pool);
+}
+
+OVXStream::OVXStream(
+    std::vector<Vertex>& vert,
+    std::vector<Indices>&& tri,
+    ThreadPool* pool
+) : _vert(vert), _pool(pool) {
+    std::vector<Indices> input = std::move(tri);
+    std::tie(_tri, _offsets) = splitIntoComponents(vert.size(), input, pool);
+}
+
+bool OVXStream::next(
+    std::vector<int>& V,
+    std::vector<int>& O,
+    std::vector<Dummy>& dummy
 ) {
-    std::vector<Vertex> vert;
-    std::vector<Indices> tri;
+    if(_next == size()){
+        return false;
+    }
+    size_t k = _next++;
 
-    int idx = 0;
-    for (const auto& [_vert, V, _, dummy] : ovx) {
-        std::unordered_set<int> dummy_set;
+    V.clear();
+    V.reserve(3 * (_offsets[k + 1] - _offsets[k]));
+    for(size_t i = _offsets[k]; i < _offsets[k + 1]; ++i){
+        V.insert(V.end(), _tri[i].begin(), _tri[i].end());
+    }
+    O.assign(V.size(), -1);
+
+    buildOpposite(V, O, V.size() >= (1 << 20) ? _pool : nullptr);
+    auto loops = findBoundaryLoops(V, O);
+    dummy.clear();
+    fill_holes(_vert, V, O, loops, dummy);
+    return true;
+}
+
+std::pair<std::vector<Vertex>, std::vector<Indices>> Converter::fromOVX(
+    const std::vector<std::tuple<std::vector<Vertex>, std::vector<int>, std::vector<int>, std::vector<Dummy>>> &ovx,
+    ThreadPool* pool
+) {
+    size_t comp_size = ovx.size();
+    std::vector<std::vector<int>> index_maps(comp_size);
+    std::vector<size_t> vert_offset(comp_size + 1, 0);
+    std::vector<size_t> tri_offset(comp_size + 1, 0);
+
+    // Count the surviving vertices and triangles of every component first, so
+    // each one can be copied straight into its slot of the merged arrays.
+    parallelFor(pool, comp_size, [&](size_t k){
+        const auto& [_vert, V, _, dummy] = ovx[k];
+        auto& index_map = index_maps[k];
+        index_map.assign(_vert.size(), 0);
         for(auto& d : dummy){
-            dummy_set.insert(d.first);
+            if(d.first >= 0 && d.first < static_cast<int>(_vert.size())){
+                index_map[d.first] = -1;
+            }
         }
-        std::vector<int> index_map(_vert.size(), -1);
-        int current_batch_count = 0;
 
-        for (int i = 0; i < _vert.size(); ++i) {
-            if (dummy_set.find(i) == dummy_set.end()) {
+        int current_batch_count = 0;
+        for (int i = 0; i < static_cast<int>(_vert.size()); ++i) {
+            if (index_map[i] != -1) {
                 index_map[i] = current_batch_count;
                 current_batch_count++;
-                vert.push_back(_vert[i]);
             }
         }
 
-        for (int i = 0; i < V.size(); i += 3) {
+        size_t tri_count = 0;
+        for (int i = 0; i < static_cast<int>(V.size()); i += 3) {
+            if (index_map[V[i]] != -1 && index_map[V[i + 1]] != -1 && index_map[V[i + 2]] != -1) {
+                ++tri_count;
+            }
+        }
+
+        vert_offset[k + 1] = current_batch_count;
+        tri_offset[k + 1] = tri_count;
+    });
+
+    for(size_t k = 0; k < comp_size; ++k){
+        vert_offset[k + 1] += vert_offset[k];
+        tri_offset[k + 1] += tri_offset[k];
+    }
+
+    std::vector<Vertex> vert(vert_offset[comp_size]);
+    std::vector<Indices> tri(tri_offset[comp_size]);
+
+    parallelFor(pool, comp_size, [&](size_t k){
+        const auto& [_vert, V, _, __] = ovx[k];
+        const auto& index_map = index_maps[k];
+        int idx = vert_offset[k];
+
+        for (int i = 0; i < static_cast<int>(_vert.size()); ++i) {
+            if (index_map[i] != -1) {
+                vert[idx + index_map[i]] = _vert[i];
+            }
+        }
+
+        size_t t = tri_offset[k];
+        for (int i = 0; i < static_cast<int>(V.size()); i += 3) {
             int v0 = V[i];
             int v1 = V[i + 1];
             int v2 = V[i + 2];
@@ -220,11 +504,44 @@ std::pair<std::vector<Vertex>, std::vector<Indices>> Converter::fromOVX(
                 continue;
             }
 
-            tri.push_back({idx + index_map[v0], idx + index_map[v1], idx + index_map[v2]});
+            tri[t++] = {idx + index_map[v0], idx + index_map[v1], idx + index_map[v2]};
         }
+    });
 
-        idx += current_batch_count;
+    return {std::move(vert), std::move(tri)};
+};
+Quantization Converter::quantize(
+    std::span<const Vertex> vert,
+    int bits
+) {
+    Quantization quant;
+    quant.bits = bits;
+    if(vert.empty()){
+        quant.step = 1;
+        return quant;
     }
 
-    return {vert, tri};
-};
+    Vertex max = vert[0];
+    quant.min = vert[0];
+    for(auto& v : vert){
+        for(int i = 0; i < 3; ++i){
+            quant.min[i] = std::min(quant.min[i], v[i]);
+            max[i] = std::max(max[i], v[i]);
+        }
+    }
+
+    // One step for all axes, so the grid keeps the aspect ratio.
+    float range = std::max({ max[0] - quant.min[0], max[1] - quant.min[1], max[2] - quant.min[2] });
+    float cells = static_cast<float>((1 << bits) - 1);
+    quant.step = range > 0 ? range / cells : 1;
+    return quant;
+}
+
+void Converter::dequantize(
+    std::vector<Vertex>& vert,
+    const Quantization& quant
+) {
+    for(auto& v : vert){
+        v = quant.fromGrid(v);
+    }
+}
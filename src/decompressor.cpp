@@ -1,12 +1,19 @@
+#include "reader.h"
 #include "decompressor.h"
+#include "prediction.h"
 #include <iostream>
+#include <algorithm>
 
 Decompressor::Decompressor(
     std::queue<Vertex> &vertices, 
     std::pair<int, std::vector<CLERS>> &clers, 
-    const std::vector<Handle> &handles
+    const HandleStream &handles,
+    bool quantized,
+    ConnectivityDecoder decoder
 ) : _vertices(vertices), 
     _H(handles),
+    _quantized(quantized),
+    _decoder(decoder),
     _M(vertices.size(), 0)
 {
     for(int i = 0; i < clers.first - 2; ++i){
@@ -29,17 +36,21 @@ void Decompressor::decompress(
     _V.resize(3 * (_clers.size() + 1), 0);
     _O.resize(3 * (_clers.size() + 1), -3);
 
-    _T = 0;
-    _N = 2;
-    _A = 0;
+    if(_decoder == ConnectivityDecoder::SPIRALE_REVERSI){
+        _decompressReversi(_V, _O);
+    }
+    else{
+        _T = 0;
+        _N = 2;
 
-    _V[0] = 0;
-    _V[1] = 2;
-    _V[2] = 1;
-    _O[0] = -1;
-    _O[1] = -1;
+        _V[0] = 0;
+        _V[1] = 2;
+        _V[2] = 1;
+        _O[0] = -1;
+        _O[1] = -1;
 
-    _decompressConectivity(2, _V, _O);
+        _decompressConectivity(2, _V, _O);
+    }
 
     _G[0] = _decodeDelta(0, _G, _V, _O);
     _M[0] = 1;
@@ -59,6 +70,9 @@ void Decompressor::_decompressConectivity(
     std::vector<int>& _V,
     std::vector<int>& _O
 ) {
+    // An S pushes its gate corner and decodes the right branch in place; when
+    // a branch ends the left branch continues at N(c) unless already glued.
+    _stack.clear();
     for(;;){
         ++_T;
         _O[c] = 3 * _T;
@@ -86,11 +100,7 @@ void Decompressor::_decompressConectivity(
             c = N(c);
             break;
         case CLERS::S:
-            _decompressConectivity(c, _V, _O);
-            c = N(c);
-            if(_O[c] >= 0){
-                return;
-            }
+            _push(c);
             break;
         case CLERS::E:
             _O[c] = -2;
@@ -99,9 +109,216 @@ void Decompressor::_decompressConectivity(
             if(!_checkHandle(N(c), _V, _O)){
                 _zip(N(c), _V, _O);
             }
-            return;
+
+            do {
+                if(_stack.empty()){
+                    return;
+                }
+                c = N(_stack.back());
+                _stack.pop_back();
+            } while(_O[c] >= 0);
+            break;
+        }
+    }
+}
+
+void Decompressor::_decompressReversi(
+    std::vector<int>& _V,
+    std::vector<int>& _O
+) {
+    // Spirale Reversi: triangles are added from the last symbol to the first.
+    // Each region decoded so far is a cycle of corners whose opposite is still
+    // open, linked through next/prev; the stack keeps the corner of every
+    // region that faces its parent triangle. Triangle t glues onto the top
+    // region, so no edge is ever looked for and every step is O(1).
+    int size = static_cast<int>(_O.size());
+    std::vector<int> next(size);
+    std::vector<int> prev(size);
+    int glued = 0;
+
+    auto link = [&](int a, int b){
+        next[a] = b;
+        prev[b] = a;
+    };
+    auto glue = [&](int a, int b){
+        if(_O[a] >= 0 || _O[b] >= 0){
+            throw ReaderException("Invalid CLERS string");
+        }
+        _O[a] = b;
+        _O[b] = a;
+        glued += 2;
+    };
+    auto top = [&](size_t depth){
+        if(_stack.size() < depth){
+            throw ReaderException("Invalid CLERS string");
+        }
+        return _stack[_stack.size() - depth];
+    };
+
+    // Handle edges are known up front; the S owning h0 finds its left edge
+    // already taken.
+    for(; !_H.empty(); _H.pop()){
+        auto& h = _H.front();
+        if(h[1] >= size){
+            throw ReaderException("Invalid handle");
+        }
+        glue(h[0], h[1]);
+    }
+
+    _stack.clear();
+    for(int t = static_cast<int>(_clers.size()); t > 0; --t){
+        int g = 3 * t;
+        int r = g + 1;
+        int l = g + 2;
+
+        switch (_clers[t - 1])
+        {
+        case CLERS::E:
+            link(g, r);
+            link(r, l);
+            link(l, g);
+            _push(g);
+            break;
+        case CLERS::C: {
+            // Closes the tip: the left edge takes the edge before the gate.
+            int G = top(1);
+            int a = prev[G];
+            int b = next[G];
+            glue(r, G);
+            glue(l, a);
+            link(prev[a], g);
+            link(g, b);
+            _stack.back() = g;
+            break;
+        }
+        case CLERS::L: {
+            int G = top(1);
+            int a = prev[G];
+            int b = next[G];
+            glue(r, G);
+            link(a, l);
+            link(l, g);
+            link(g, b);
+            _stack.back() = g;
+            break;
+        }
+        case CLERS::R: {
+            int G = top(1);
+            int a = prev[G];
+            int b = next[G];
+            glue(l, G);
+            link(a, g);
+            link(g, r);
+            link(r, b);
+            _stack.back() = g;
+            break;
+        }
+        case CLERS::S:
+            if(_O[l] >= 0){
+                // The left branch was swallowed through a handle, so the left
+                // edge is matched inside the right region. Taking it out either
+                // joins two cycles or splits one off for a later handle S.
+                int G = top(1);
+                int h = _O[l];
+                int a = prev[G];
+                int b = next[G];
+                int p = prev[h];
+                int q = next[h];
+                glue(r, G);
+                link(g, b);
+                link(p, g);
+                if(h != a){
+                    link(a, q);
+                }
+                _stack.back() = g;
+            }
+            else{
+                // The right branch was decoded last, so it is on top.
+                int G1 = top(1);
+                int G2 = top(2);
+                _stack.pop_back();
+                glue(r, G1);
+                glue(l, G2);
+                int a1 = prev[G1];
+                int b1 = next[G1];
+                int a2 = prev[G2];
+                int b2 = next[G2];
+                link(g, b1);
+                link(a1, b2);
+                link(a2, g);
+                _stack.back() = g;
+            }
+            break;
         }
     }
+
+    // What is left faces the three edges of triangle 0.
+    int G = top(1);
+    if(_stack.size() != 1 || next[next[next[G]]] != G){
+        throw ReaderException("Invalid CLERS string");
+    }
+    glue(2, G);
+    glue(1, next[G]);
+    glue(0, next[next[G]]);
+    if(glued != size){
+        throw ReaderException("Invalid CLERS string");
+    }
+
+    _labelVertices(_V, _O);
+}
+
+void Decompressor::_labelVertices(
+    std::vector<int>& _V,
+    std::vector<int>& _O
+) {
+    // Labels follow the forward order: a C tip is a new vertex, the other
+    // corners copy from the parent or from the earlier triangle they are glued
+    // to. Only an S tip has no earlier neighbour; it is found by walking its
+    // fan, and the corners passed are labelled too so no walk repeats them.
+    std::fill(_V.begin(), _V.end(), -1);
+    _V[0] = 0;
+    _V[1] = 2;
+    _V[2] = 1;
+
+    int v = 2;
+    for(int t = 1; t <= static_cast<int>(_clers.size()); ++t){
+        int g = 3 * t;
+        int c = _O[g];
+        _V[g + 1] = _V[P(c)];
+        _V[g + 2] = _V[N(c)];
+
+        switch (_clers[t - 1])
+        {
+        case CLERS::C:
+            _V[g] = ++v;
+            break;
+        case CLERS::L:
+            _V[g] = _V[P(_O[g + 2])];
+            break;
+        case CLERS::R:
+        case CLERS::E:
+            _V[g] = _V[N(_O[g + 1])];
+            break;
+        case CLERS::S: {
+            int a = P(_O[P(g)]);
+            while(_V[a] < 0 && a != g){
+                a = P(_O[P(a)]);
+            }
+            int label = _V[a];
+            for(a = g; _V[a] < 0; a = P(_O[P(a)])){
+                _V[a] = label;
+            }
+            break;
+        }
+        }
+
+        if((_V[g] | _V[g + 1] | _V[g + 2]) < 0){
+            throw ReaderException("Invalid CLERS string");
+        }
+    }
+    if(v + 1 != static_cast<int>(_M.size())){
+        throw ReaderException("Vertex count does not match the CLERS string");
+    }
 }
 
 void Decompressor::_decompressVertices(
@@ -110,6 +327,7 @@ void Decompressor::_decompressVertices(
     std::vector<int>& _V,
     std::vector<int>& _O
 ) {
+    _stack.clear();
     for(;;){
         _U[T(c)] = 1;
         if(_M[_V[c]] == 0){
@@ -120,7 +338,13 @@ void Decompressor::_decompressVertices(
         }
         else if(_U[T(R(_O, c))] == 1){
             if(_U[T(L(_O, c))] == 1){
-                return;
+                do {
+                    if(_stack.empty()){
+                        return;
+                    }
+                    c = _stack.back();
+                    _stack.pop_back();
+                } while(_U[T(c)] > 0);
             }
             else{
                 c = L(_O, c);
@@ -130,29 +354,38 @@ void Decompressor::_decompressVertices(
             c = R(_O, c);
         }
         else{
-            _decompressVertices(R(_O, c), _G, _V, _O);
-            c = L(_O, c);
-            if(_U[T(c)] > 0){
-                return;
-            }
+            _push(L(_O, c));
+            c = R(_O, c);
         }
     }
 }
 
+void Decompressor::_push(int c) {
+    _stack.push_back(c);
+    _peak = std::max(_peak, _stack.size());
+}
+
+size_t Decompressor::peakStackBytes() const {
+    return _peak * sizeof(int);
+}
+
 bool Decompressor::_checkHandle(
     int c,
     std::vector<int>& _V,
     std::vector<int>& _O
 ) {
-    if(_A >= _H.size() || c != _H[_A][1]){
+    if(_H.empty() || c != _H.front()[1]){
         return false;
     }
     else{
-        _O[c] = _H[_A][0];
-        _O[_H[_A][0]] = c;
+        int h = _H.front()[0];
+        _H.pop();
+
+        _O[c] = h;
+        _O[h] = c;
 
         int a = P(c);
-        while(_O[a] >= 0 && a != _H[_A][0]){
+        while(_O[a] >= 0 && a != h){
             a = P(_O[a]);
         }
         if(_O[a] == -2){
@@ -167,7 +400,6 @@ bool Decompressor::_checkHandle(
             _zip(a, _V, _O);
         }
 
-        ++_A;
         return true;
     }
 }
@@ -177,30 +409,34 @@ void Decompressor::_zip(
     std::vector<int>& _V,
     std::vector<int>& _O
 ) {
-    int b = N(c);
-    while(_O[b] >= 0 && _O[b] != c){
-        b = N(_O[b]);
-    }
-    if(_O[b] != -1){
-        return;
-    }
-
-    _O[c] = b;
-    _O[b] = c;
-    int a = N(c);
-    _V[N(a)] = _V[N(b)];
+    // Each glued edge may expose the next one to zip, so keep going while the
+    // corner found on the left is still marked.
+    for(;;){
+        int b = N(c);
+        while(_O[b] >= 0 && _O[b] != c){
+            b = N(_O[b]);
+        }
+        if(_O[b] != -1){
+            return;
+        }
 
-    while(_O[a] >= 0 && a != b) {
-        a = N(_O[a]);
+        _O[c] = b;
+        _O[b] = c;
+        int a = N(c);
         _V[N(a)] = _V[N(b)];
-    }
 
-    c = P(c);
-    while(_O[c] >= 0 && c != b){
-        c = P(_O[c]);
-    }
-    if(_O[c] == -2){
-        _zip(c, _V, _O);
+        while(_O[a] >= 0 && a != b) {
+            a = N(_O[a]);
+            _V[N(a)] = _V[N(b)];
+        }
+
+        c = P(c);
+        while(_O[c] >= 0 && c != b){
+            c = P(_O[c]);
+        }
+        if(_O[c] != -2){
+            return;
+        }
     }
 }
 
@@ -213,23 +449,10 @@ Vertex Decompressor::_decodeDelta(
     Vertex delta = _vertices.front();
     _vertices.pop();
 
-    if (_M[_V[_O[c]]] > 0 && _M[_V[P(c)]] > 0) {
-        // Case 1: a, b, d known (a + b - d)
-        return delta + (_G[_V[N(c)]] + _G[_V[P(c)]] - _G[_V[_O[c]]]);
-    } else if (_M[_V[_O[c]]] > 0) {
-        // Case 2: a and d known (2a - d)
-        return delta + (2 * _G[_V[N(c)]] - _G[_V[_O[c]]]);
-    } else if (_M[_V[N(c)]] > 0 && _M[_V[P(c)]] > 0) {
-        // Case 3: a and b known ((a + b)/2)
-        return delta + ((_G[_V[N(c)]] + _G[_V[P(c)]]) / 2.0f);
-    } else if (_M[_V[N(c)]] > 0) {
-        // Case 4: a known (a)
-        return delta + _G[_V[N(c)]];
-    } else if (_M[_V[P(c)]] > 0) {
-        // Case 5: b known (b)
-        return delta + _G[_V[P(c)]];
-    }
-
-    // Case 6: nothing known
-    return delta;
+    auto k = predictionCase(_M[_V[N(c)]] > 0, _M[_V[P(c)]] > 0, _M[_V[_O[c]]] > 0);
+    ++_cases[static_cast<size_t>(k)];
+    auto& A = _G[_V[N(c)]];
+    auto& B = _G[_V[P(c)]];
+    auto& D = _G[_V[_O[c]]];
+    return delta + (_quantized ? predictQuantized(k, A, B, D) : predict(k, A, B, D));
 }
\ No newline at end of file
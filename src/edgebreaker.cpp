@@ -0,0 +1,310 @@
+#include "edgebreaker.h"
+
+#include <algorithm>
+#include <mutex>
+#include <numeric>
+#include <optional>
+
+#include "reader.h"
+#include "writer.h"
+#include "converter.h"
+#include "compressor.h"
+#include "decompressor.h"
+
+#pragma region HELPERS
+
+// Runs f, timed as the named stage when there are stats to record it in.
+template<typename F>
+void timed(Stats* stats, const std::string& stage, F&& f) {
+    if (stats) stats->time(stage, f);
+    else f();
+}
+
+void countCLERS(
+    const std::vector<CLERS>& clers,
+    ComponentStats& stats
+) {
+    for (auto c : clers) {
+        ++stats.clers[static_cast<size_t>(c)];
+    }
+}
+
+#pragma endregion
+
+BCOSizes EdgeBreaker::compress(
+    std::span<const Vertex> vert,
+    std::span<const Indices> tri,
+    std::vector<uint8_t>& out,
+    const CompressOptions& options
+) {
+    if (options.quant_bits < 0 || options.quant_bits > 22) {
+        throw WriterException("Quantization bits must be between 0 and 22 (0 disables quantization)");
+    }
+
+    ThreadPool pool(options.threads);
+
+    // Hole filling appends dummy vertices, so both arrays are copied.
+    CompressBuffers buffers;
+    buffers.vert.assign(vert.begin(), vert.end());
+    buffers.tri.assign(tri.begin(), tri.end());
+    buildMesh(buffers, options.quant_bits, &pool);
+    compressMesh(buffers, &pool);
+
+    out.clear();
+    BCOStreamWriter writer(out, buffers.compressed.size(), buffers.quant, options.clers_coder, options.vertex_coder);
+    for (size_t i = 0; i < buffers.compressed.size(); ++i) {
+        auto& [vertices, clers, handles, dummy] = buffers.compressed[i];
+        writer.append(vertices, clers, handles, dummy, buffers.info[i]);
+    }
+    return writer.finish();
+}
+
+void EdgeBreaker::decompress(
+    std::span<const uint8_t> data,
+    std::vector<Vertex>& vert,
+    std::vector<Indices>& tri,
+    const DecompressOptions& options
+) {
+    auto [quant, uncompressed] = options.components.empty()
+        ? Reader::read_Compressed_BIN(data)
+        : Reader::read_Compressed_BIN(data, options.components);
+
+    ThreadPool pool(options.threads);
+    auto [ovx, peak_stack] = decompressComponents(uncompressed, quant, options.decoder, &pool);
+    std::tie(vert, tri) = Converter::fromOVX(ovx, &pool);
+}
+
+void EdgeBreaker::buildMesh(
+    CompressBuffers& buffers,
+    int quant_bits,
+    ThreadPool* pool,
+    Stats* stats
+) {
+    // The box is taken before hole filling adds its dummies.
+    buffers.quant = quant_bits > 0 ? Converter::quantize(buffers.vert, quant_bits) : Quantization{};
+    timed(stats, "toOVX", [&]{
+        Converter::toOVX(buffers.vert, buffers.tri, buffers.built, pool);
+    });
+
+    buffers.view = buffers.vert;
+    buffers.ovx.clear();
+    for (auto& [V, O, dummy] : buffers.built) {
+        buffers.ovx.emplace_back(V, O, dummy);
+    }
+}
+
+void EdgeBreaker::mapMesh(
+    CompressBuffers& buffers,
+    const MappedOVX& mapped,
+    int quant_bits
+) {
+    buffers.quant = quant_bits > 0 ? Converter::quantize(mapped.vert, quant_bits) : Quantization{};
+    buffers.view = mapped.vert;
+    buffers.ovx.clear();
+    for (auto& [V, O, dummy] : mapped.ovx) {
+        buffers.ovx.emplace_back(V, O, dummy);
+    }
+}
+
+void EdgeBreaker::compressMesh(
+    CompressBuffers& buffers,
+    ThreadPool* pool,
+    const Progress& progress,
+    Stats* stats
+) {
+    size_t n = buffers.ovx.size();
+    buffers.compressed.resize(n);
+    buffers.info.resize(n);
+    if (stats) stats->components().resize(n);
+    timed(stats, "compress", [&]{
+        compressComponents(buffers.view, buffers.ovx, buffers.quant, buffers.compressed, buffers.info, pool, progress,
+            stats ? std::span(stats->components()) : std::span<ComponentStats>());
+    });
+}
+
+BCOSizes EdgeBreaker::compressStream(
+    CompressBuffers& buffers,
+    const MappedOVX* mapped,
+    const std::string& outfile,
+    const CompressOptions& options,
+    ThreadPool* pool,
+    const Progress& progress,
+    Stats* stats
+) {
+    constexpr size_t BATCH_CORNERS = 1 << 22;
+
+    std::optional<OVXStream> stream;
+    size_t count = 0;
+    if (mapped) {
+        mapMesh(buffers, *mapped, options.quant_bits);
+        count = buffers.ovx.size();
+    }
+    else {
+        buffers.quant = options.quant_bits > 0 ? Converter::quantize(buffers.vert, options.quant_bits) : Quantization{};
+        timed(stats, "toOVX", [&]{
+            stream.emplace(buffers.vert, std::move(buffers.tri), pool);
+        });
+        count = stream->size();
+    }
+
+    BCOStreamWriter out(outfile, count, buffers.quant, options.clers_coder, options.vertex_coder);
+    if (stats) stats->components().resize(count);
+
+    // One component per thread, or fewer when they are big.
+    size_t slots = std::max<size_t>(pool ? pool->size() : 1, 1);
+    auto views = std::move(buffers.ovx);
+    buffers.built.resize(slots);
+    buffers.ovx.resize(slots);
+    buffers.compressed.resize(slots);
+    buffers.info.resize(slots);
+
+    for (size_t done = 0; done < count;) {
+        size_t n = 0;
+        size_t corners = 0;
+        timed(stats, "toOVX", [&]{
+            while (n < slots && done + n < count && (n == 0 || corners < BATCH_CORNERS)) {
+                if (stream) {
+                    auto& [V, O, dummy] = buffers.built[n];
+                    stream->next(V, O, dummy);
+                    buffers.ovx[n] = { V, O, dummy };
+                }
+                else {
+                    buffers.ovx[n] = views[done + n];
+                }
+                corners += std::get<0>(buffers.ovx[n]).size();
+                ++n;
+            }
+        });
+
+        // Dummy vertices were appended while building, so take the view now.
+        buffers.view = stream ? std::span<const Vertex>(buffers.vert) : mapped->vert;
+        auto batch_stats = stats ? std::span(stats->components()).subspan(done, n) : std::span<ComponentStats>();
+        timed(stats, "compress", [&]{
+            compressComponents(buffers.view, std::span(buffers.ovx).first(n), buffers.quant,
+                std::span(buffers.compressed).first(n), std::span(buffers.info).first(n), pool, {}, batch_stats);
+        });
+
+        timed(stats, "write", [&]{
+            for (size_t i = 0; i < n; ++i) {
+                auto& [vertices, clers, handles, dummy] = buffers.compressed[i];
+                out.append(vertices, clers, handles, dummy, buffers.info[i]);
+            }
+        });
+        done += n;
+        if (progress) progress(done, count);
+    }
+
+    BCOSizes sizes;
+    timed(stats, "write", [&]{
+        sizes = out.finish();
+    });
+    return sizes;
+}
+
+void EdgeBreaker::compressComponents(
+    std::span<const Vertex> vert,
+    std::span<const std::tuple<std::span<const int>, std::span<const int>, std::span<const Dummy>>> ovx,
+    const Quantization& quant,
+    std::span<std::tuple<std::vector<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>> compressed,
+    std::span<ComponentInfo> info,
+    ThreadPool* pool,
+    const Progress& progress,
+    std::span<ComponentStats> stats
+) {
+    // Largest components first, so a big one does not end up alone at the tail.
+    std::vector<size_t> order(ovx.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){
+        return std::get<0>(ovx[a]).size() > std::get<0>(ovx[b]).size();
+    });
+
+    std::mutex progress_mutex;
+    size_t done = 0;
+    parallelFor(pool, order, [&](size_t i){
+        auto& [V, O, dummy] = ovx[i];
+        auto& [vertices, clers, handles, _dummy] = compressed[i];
+        vertices.clear();
+        clers.second.clear();
+        handles.clear();
+        _dummy.assign(dummy.begin(), dummy.end());
+
+        Compressor c(vert, V, O, quant);
+        c.compress(0, vertices, clers, handles, _dummy);
+        info[i] = c.info();
+
+        if (!stats.empty()) {
+            auto& s = stats[i];
+            s = {};
+            s.triangles = info[i].triangles;
+            s.vertices = info[i].vertices;
+            s.dummies = _dummy.size();
+            s.handles = handles.size();
+            countCLERS(clers.second, s);
+            s.prediction = c.predictionCases();
+        }
+
+        if (progress) {
+            std::lock_guard lock(progress_mutex);
+            progress(++done, ovx.size());
+        }
+    });
+}
+
+std::pair<std::vector<std::tuple<std::vector<Vertex>, std::vector<int>, std::vector<int>, std::vector<Dummy>>>, size_t> EdgeBreaker::decompressComponents(
+    std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>>& uncompressed,
+    const Quantization& quant,
+    ConnectivityDecoder decoder,
+    ThreadPool* pool,
+    const Progress& progress,
+    std::span<ComponentStats> stats
+) {
+    std::vector<std::tuple<std::vector<Vertex>, std::vector<int>, std::vector<int>, std::vector<Dummy>>> ovx(uncompressed.size());
+
+    std::vector<size_t> order(uncompressed.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){
+        return std::get<1>(uncompressed[a]).second.size() > std::get<1>(uncompressed[b]).second.size();
+    });
+
+    std::mutex progress_mutex;
+    size_t done = 0;
+    size_t peak_stack = 0;
+    parallelFor(pool, order, [&](size_t i){
+        auto& [vertices, clers, handles, dummy] = uncompressed[i];
+        auto& [vert, V, O, _dummy] = ovx[i];
+        _dummy = dummy;
+
+        if (!stats.empty()) {
+            auto& s = stats[i];
+            s = {};
+            s.dummies = dummy.size();
+            s.handles = handles.count;
+            countCLERS(clers.second, s);
+        }
+
+        Decompressor d(vertices, clers, handles, quant.bits > 0, decoder);
+        d.decompress(vert, V, O);
+        if (quant.bits > 0) {
+            Converter::dequantize(vert, quant);
+        }
+
+        if (!stats.empty()) {
+            // Dummies and the triangles around them are dropped from the output.
+            auto& s = stats[i];
+            std::vector<bool> is_dummy(vert.size(), false);
+            for (auto& [index, position] : dummy) {
+                if (index >= 0 && index < static_cast<int>(vert.size())) is_dummy[index] = true;
+            }
+            s.vertices = vert.size() - std::count(is_dummy.begin(), is_dummy.end(), true);
+            for (size_t c = 0; c < V.size(); c += 3) {
+                if (!is_dummy[V[c]] && !is_dummy[V[c + 1]] && !is_dummy[V[c + 2]]) ++s.triangles;
+            }
+            s.prediction = d.predictionCases();
+        }
+
+        std::lock_guard lock(progress_mutex);
+        peak_stack = std::max(peak_stack, d.peakStackBytes());
+        if (progress) progress(++done, uncompressed.size());
+    });
+    return { std::move(ovx), peak_stack };
+}
@@ -1,10 +1,17 @@
 #include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 
+#include "edgebreaker.h"
 #include "converter.h"
 #include "reader.h"
 #include "writer.h"
-#include "compressor.h"
-#include "decompressor.h"
+#include "thread_pool.h"
+#include "stats.h"
+#include "batch.h"
 
 #include "types.h"
 #include "arg_parser.h"
@@ -15,17 +22,19 @@ std::streamsize getFileSize(const std::string& filename) {
 }
 
 void ovx(const Args& args){
+    ThreadPool pool(args.threads);
+
     std::vector<Vertex> vert;
     std::vector<std::tuple<std::vector<int>, std::vector<int>, std::vector<Dummy>>> _ovx;
     if(args.infile_type == File::Type::OBJ){
-        auto [_vert, tri] = Reader::read_OBJ(args.infile);
+        auto [_vert, tri] = Reader::read_OBJ(args.infile, &pool);
         vert = _vert;
-        _ovx = Converter::toOVX(vert, tri);
+        _ovx = Converter::toOVX(vert, tri, &pool);
     }
     else if(args.infile_type == File::Type::OFF){
         auto [_vert, tri] = Reader::read_OFF(args.infile);
         vert = _vert;
-        _ovx = Converter::toOVX(vert, tri);
+        _ovx = Converter::toOVX(vert, tri, &pool);
     }
 
     Writer::write_OVX(args.outfile, vert, _ovx);
@@ -33,108 +42,346 @@ void ovx(const Args& args){
     std::cout << std::format("Converted file {} into {}\n", args.infile, args.outfile);
 }
 
-void compress(const Args& args){
-    using Clock = std::chrono::high_resolution_clock;
-    auto t_start = Clock::now();
+// Prints a progress line only when another whole percent is done, so runs
+// with many small components do not spend their time printing.
+Progress printProgress(const std::string& label, bool quiet){
+    if(quiet) return {};
+    return [label, last = -1](size_t done, size_t total) mutable {
+        int percent = static_cast<int>(done * 100 / total);
+        if(percent == last) return;
+        last = percent;
+        std::cout << std::format("{} progress: {:.2f}%\n", label, done * 100 / (float)total);
+    };
+}
 
-    std::vector<Vertex> vert;
-    std::vector<std::tuple<std::vector<int>, std::vector<int>, std::vector<Dummy>>> ovx;
-    if(args.infile_type == File::Type::OBJ){
-        auto [_vert, tri] = Reader::read_OBJ(args.infile);
-        vert = _vert;
-        ovx = Converter::toOVX(vert, tri);
+// Reads the input of compress into buffers, or maps it when it is an OVX file.
+void readMesh(const std::string& infile, File::Type type, CompressBuffers& buffers, MappedOVX& mapped, ThreadPool* pool){
+    if(type == File::Type::OVX){
+        mapped = Reader::read_OVX(infile);
     }
-    else if(args.infile_type == File::Type::OFF){
-        auto [_vert, tri] = Reader::read_OFF(args.infile);
-        vert = _vert;
-        ovx = Converter::toOVX(vert, tri);
+    else if(type == File::Type::OBJ){
+        Reader::read_OBJ(infile, buffers.vert, buffers.tri, pool);
     }
-    else if(args.infile_type == File::Type::OVX){
-        auto [_vert, _ovx] = Reader::read_OVX(args.infile);
-        vert = _vert;
-        ovx = _ovx;
+    else{
+        Reader::read_OFF(infile, buffers.vert, buffers.tri);
     }
+}
 
-    std::vector<std::tuple<std::vector<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>> compressed;
-    int progress = 1;
-    for(auto& [V, O, dummy] : ovx){
-        std::cout << std::format("Compressing progress: {:.2f}%\n", progress * 100 / (float)ovx.size());
-        auto& [vertices, clers, handles, _dummy] = compressed.emplace_back();
-        for(auto d : dummy){
-            _dummy.push_back(d);
-        }
-
-        Compressor c(vert, V, O);
-        c.compress(0, vertices, clers, handles, _dummy);
-        ++progress;
+// What compress and compressStream print when they are done: the --stats
+// JSON, or the sizes, ratio and time.
+void reportCompress(const Args& args, Stats& stats, const BCOSizes& sizes, std::chrono::high_resolution_clock::time_point t_start){
+    auto infile_size = getFileSize(args.infile);
+    auto outfile_size = getFileSize(args.outfile);
+    if(args.stats){
+        stats.files(args.infile, infile_size, args.outfile, outfile_size);
+        stats.write(std::cout);
+        return;
     }
 
     if(args.outfile_type == File::Type::BCO){
-        Writer::write_Compressed_BIN(args.outfile, compressed);
+        std::cout << std::format("Geometry: {:.2f} bits per vertex, connectivity: {:.2f} bits per triangle\n",
+            sizes.geometry * 8.0 / std::max<size_t>(sizes.vertices, 1),
+            sizes.connectivity * 8.0 / std::max<size_t>(sizes.triangles, 1));
     }
-    else{
-        Writer::write_Compressed(args.outfile, compressed);
-    }
-
-    auto infile_size = getFileSize(args.infile);
-    auto outfile_size = getFileSize(args.outfile);
     std::cout << std::format("Compression ratio: {:.2f}\n", outfile_size / (float)infile_size);
     std::cout << std::format("Relative savings: {:.2f}%\n", ((infile_size - outfile_size) / (float)infile_size) * 100);
     std::cout << std::format("Compressed file {} into {}\n", args.infile, args.outfile);
 
-    auto t_end = Clock::now();
+    auto t_end = std::chrono::high_resolution_clock::now();
     auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(t_end - t_start).count();
     std::cout << std::format("Total compression time: {} ms\n", elapsed);
 }
 
-void decompress(const Args& args){
+void compress(const Args& args){
     using Clock = std::chrono::high_resolution_clock;
     auto t_start = Clock::now();
 
-    std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>> uncompressed;
-    if(args.infile_type == File::Type::BCO){
-        uncompressed = Reader::read_Compressed_BIN(args.infile);
+    ThreadPool pool(args.threads);
+    Stats stats("compress");
+    // Stage times and counters are only gathered for --stats.
+    Stats* collect = args.stats ? &stats : nullptr;
+
+    CompressBuffers buffers;
+    MappedOVX mapped;
+    stats.time("read", [&]{
+        readMesh(args.infile, args.infile_type, buffers, mapped, &pool);
+    });
+    if(args.infile_type == File::Type::OVX){
+        EdgeBreaker::mapMesh(buffers, mapped, args.quant_bits);
     }
     else{
-        uncompressed = Reader::read_Compressed(args.infile);
+        EdgeBreaker::buildMesh(buffers, args.quant_bits, &pool, collect);
     }
+    EdgeBreaker::compressMesh(buffers, &pool, printProgress("Compressing", args.stats), collect);
 
-    std::vector<std::tuple<std::vector<Vertex>, std::vector<int>, std::vector<int>, std::vector<Dummy>>> ovx;
-    int progress = 1;
-    for(auto& [vertices, clers, handles, dummy] : uncompressed){
-        std::cout << std::format("Decompressing progress: {:.2f}%\n", progress * 100 / (float)uncompressed.size());
-        auto& [vert, V, O, _dummy] = ovx.emplace_back();
-        for(auto d : dummy){
-            _dummy.push_back(d);
+    BCOSizes sizes;
+    stats.time("write", [&]{
+        if(args.outfile_type == File::Type::BCO){
+            sizes = Writer::write_Compressed_BIN(args.outfile, buffers.compressed, buffers.info, buffers.quant, args.clers_coder, args.vertex_coder);
+            stats.sizes(sizes);
         }
+        else{
+            Writer::write_Compressed(args.outfile, buffers.compressed);
+        }
+    });
 
-        Decompressor d(vertices, clers, handles);
-        d.decompress(vert, V, O);
-        ++progress;
-    }
+    reportCompress(args, stats, sizes, t_start);
+}
+
+// Same output as compress, but components are built, compressed and appended
+// to the file a batch at a time, see EdgeBreaker::compressStream.
+void compressStream(const Args& args){
+    using Clock = std::chrono::high_resolution_clock;
+    auto t_start = Clock::now();
+
+    ThreadPool pool(args.threads);
+    Stats stats("compress");
+    // Stage times and counters are only gathered for --stats.
+    Stats* collect = args.stats ? &stats : nullptr;
+
+    CompressBuffers buffers;
+    MappedOVX mapped;
+    stats.time("read", [&]{
+        readMesh(args.infile, args.infile_type, buffers, mapped, &pool);
+    });
+
+    CompressOptions options{ .threads = args.threads, .quant_bits = args.quant_bits, .clers_coder = args.clers_coder, .vertex_coder = args.vertex_coder };
+    auto sizes = EdgeBreaker::compressStream(buffers, args.infile_type == File::Type::OVX ? &mapped : nullptr, args.outfile, options,
+        &pool, printProgress("Compressing", args.stats), collect);
+    stats.sizes(sizes);
 
-    auto [vert, tri] = Converter::fromOVX(ovx);
-    if(args.outfile_type == File::Type::OBJ){
-        Writer::write_OBJ(args.outfile, vert, tri);
+    reportCompress(args, stats, sizes, t_start);
+}
+
+int decompress(const Args& args){
+    using Clock = std::chrono::high_resolution_clock;
+    auto t_start = Clock::now();
+
+    Stats stats("decompress");
+
+    // A bad or corrupt input, or a component the file does not have, is
+    // reported instead of ending the process.
+    Quantization quant;
+    std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>> uncompressed;
+    std::vector<ComponentInfo> index;
+    try{
+        stats.time("read", [&]{
+            if(args.infile_type == File::Type::BCO && !args.components.empty()){
+                std::tie(quant, uncompressed) = Reader::read_Compressed_BIN(args.infile, args.components, &index);
+            }
+            else if(args.infile_type == File::Type::BCO){
+                std::tie(quant, uncompressed) = Reader::read_Compressed_BIN(args.infile);
+            }
+            else{
+                uncompressed = Reader::read_Compressed(args.infile);
+            }
+        });
     }
-    else if(args.outfile_type == File::Type::OFF){
-        Writer::write_OFF(args.outfile, vert, tri);
+    catch(const ReaderException& e){
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    if(!args.components.empty() && !args.stats){
+        for(auto i : args.components){
+            auto& [triangles, vertices, min, max] = index[i];
+            std::cout << std::format("Component {}: {} triangles, {} vertices, bounds ({}, {}, {}) - ({}, {}, {})\n",
+                i, triangles, vertices, min[0], min[1], min[2], max[0], max[1], max[2]);
+        }
+    }
+
+    ThreadPool pool(args.threads);
+    if(args.stats) stats.components().resize(uncompressed.size());
+    std::vector<std::tuple<std::vector<Vertex>, std::vector<int>, std::vector<int>, std::vector<Dummy>>> ovx;
+    size_t peak_stack = 0;
+    stats.time("decompress", [&]{
+        std::tie(ovx, peak_stack) = EdgeBreaker::decompressComponents(uncompressed, quant, args.decoder, &pool, printProgress("Decompressing", args.stats), stats.components());
+    });
+
+    std::vector<Vertex> vert;
+    std::vector<Indices> tri;
+    stats.time("fromOVX", [&]{
+        std::tie(vert, tri) = Converter::fromOVX(ovx, &pool);
+    });
+    stats.time("write", [&]{
+        if(args.outfile_type == File::Type::OBJ){
+            Writer::write_OBJ(args.outfile, vert, tri);
+        }
+        else if(args.outfile_type == File::Type::OFF){
+            Writer::write_OFF(args.outfile, vert, tri);
+        }
+    });
+
+    if(args.stats){
+        stats.files(args.infile, getFileSize(args.infile), args.outfile, getFileSize(args.outfile));
+        stats.write(std::cout);
+        return EXIT_SUCCESS;
     }
 
+    std::cout << std::format("Peak traversal stack: {} bytes\n", peak_stack);
     std::cout << std::format("Decompressed file {} into {}\n", args.infile, args.outfile);
 
     auto t_end = Clock::now();
     auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(t_end - t_start).count();
     std::cout << std::format("Total decompression time: {} ms\n", elapsed);
+    return EXIT_SUCCESS;
+}
+
+struct BatchResult {
+    size_t infile_size = 0;
+    size_t outfile_size = 0;
+    size_t triangles = 0;
+    std::string error;
+};
+
+// Compresses one file of a batch on the calling thread. buffers belongs to
+// the worker and is reused from file to file.
+BatchResult compressBatchFile(const Args& args, const BatchJob& job, CompressBuffers& buffers){
+    if(job.infile_type != File::Type::OBJ && job.infile_type != File::Type::OFF && job.infile_type != File::Type::OVX){
+        throw ReaderException(std::format("Unsupported input file type {}!", job.infile));
+    }
+    if(job.outfile_type != File::Type::BCO && job.outfile_type != File::Type::CO){
+        throw WriterException(std::format("Unsupported output file type {}!", job.outfile));
+    }
+    bool bco_only = args.quant_bits > 0 || args.clers_coder != CLERSCoder::PREFIX || args.vertex_coder != VertexCoder::RAW;
+    if(bco_only && job.outfile_type != File::Type::BCO){
+        throw WriterException(std::format("--quant-bits and the coders require a .bco output, got {}!", job.outfile));
+    }
+
+    MappedOVX mapped;
+    readMesh(job.infile, job.infile_type, buffers, mapped, nullptr);
+    if(job.infile_type == File::Type::OVX){
+        EdgeBreaker::mapMesh(buffers, mapped, args.quant_bits);
+    }
+    else{
+        EdgeBreaker::buildMesh(buffers, args.quant_bits);
+    }
+    EdgeBreaker::compressMesh(buffers);
+
+    std::error_code ec;
+    auto dir = std::filesystem::path(job.outfile).parent_path();
+    if(!dir.empty()) std::filesystem::create_directories(dir, ec);
+
+    if(job.outfile_type == File::Type::BCO){
+        Writer::write_Compressed_BIN(job.outfile, buffers.compressed, buffers.info, buffers.quant, args.clers_coder, args.vertex_coder);
+    }
+    else{
+        Writer::write_Compressed(job.outfile, buffers.compressed);
+    }
+
+    BatchResult result;
+    result.infile_size = getFileSize(job.infile);
+    result.outfile_size = getFileSize(job.outfile);
+    for(auto& info : buffers.info){
+        result.triangles += info.triangles;
+    }
+    return result;
+}
+
+// Compresses every file of a manifest, directory or pattern in one process.
+// Files are spread over the pool, largest first, and each one is compressed on
+// a single thread. A file that fails is reported and the rest carry on.
+int batch(const Args& args){
+    using Clock = std::chrono::high_resolution_clock;
+    auto t_start = Clock::now();
+
+    std::vector<BatchJob> jobs;
+    try{
+        jobs = listBatch(args.infile, args.outfile);
+    }
+    catch(const ReaderException& e){
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<BatchResult> results(jobs.size());
+    std::unordered_map<std::string, size_t> outputs;
+    std::vector<size_t> order;
+    for(size_t i = 0; i < jobs.size(); ++i){
+        auto [it, inserted] = outputs.emplace(jobs[i].outfile, i);
+        if(!inserted){
+            results[i].error = std::format("Output {} is also written by {}", jobs[i].outfile, jobs[it->second].infile);
+            continue;
+        }
+        results[i].infile_size = std::max<std::streamsize>(getFileSize(jobs[i].infile), 0);
+        order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){
+        return results[a].infile_size > results[b].infile_size;
+    });
+
+    ThreadPool pool(args.threads);
+    std::mutex mutex;
+    std::vector<std::unique_ptr<CompressBuffers>> idle;
+    auto progress = printProgress("Compressing", false);
+    size_t done = 0;
+    parallelFor(&pool, order, [&](size_t i){
+        std::unique_ptr<CompressBuffers> buffers;
+        {
+            std::lock_guard lock(mutex);
+            if(!idle.empty()){
+                buffers = std::move(idle.back());
+                idle.pop_back();
+            }
+        }
+        if(!buffers) buffers = std::make_unique<CompressBuffers>();
+
+        BatchResult result;
+        try{
+            result = compressBatchFile(args, jobs[i], *buffers);
+        }
+        catch(const std::exception& e){
+            result.infile_size = results[i].infile_size;
+            result.error = e.what();
+        }
+
+        std::lock_guard lock(mutex);
+        results[i] = std::move(result);
+        idle.push_back(std::move(buffers));
+        progress(++done, order.size());
+    });
+
+    size_t failed = 0;
+    size_t infile_bytes = 0;
+    size_t outfile_bytes = 0;
+    size_t triangles = 0;
+    for(size_t i = 0; i < jobs.size(); ++i){
+        if(!results[i].error.empty()){
+            std::cerr << std::format("Failed {}: {}\n", jobs[i].infile, results[i].error);
+            ++failed;
+            continue;
+        }
+        infile_bytes += results[i].infile_size;
+        outfile_bytes += results[i].outfile_size;
+        triangles += results[i].triangles;
+    }
+
+    auto t_end = Clock::now();
+    double seconds = std::max(std::chrono::duration<double>(t_end - t_start).count(), 1e-9);
+    std::cout << std::format("Compressed {} of {} files into {}, {} failed\n", jobs.size() - failed, jobs.size(), args.outfile, failed);
+    if(infile_bytes > 0){
+        std::cout << std::format("Compression ratio: {:.2f}\n", outfile_bytes / (float)infile_bytes);
+    }
+    std::cout << std::format("Throughput: {:.1f} files/s, {:.2f} MB/s, {:.0f} triangles/s\n",
+        (jobs.size() - failed) / seconds, infile_bytes / seconds / 1e6, triangles / seconds);
+    std::cout << std::format("Total batch time: {} ms\n", std::chrono::duration_cast<std::chrono::milliseconds>(t_end - t_start).count());
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 int main(int argc, char* argv[]) {
     auto args = parseArgs(argc, argv);
     if(args.mode == "compress"){
-        compress(args);
+        if(args.stream){
+            compressStream(args);
+        }
+        else{
+            compress(args);
+        }
     }
     else if(args.mode == "decompress"){
-        decompress(args);
+        return decompress(args);
+    }
+    else if(args.mode == "batch"){
+        return batch(args);
     }
     else{
         ovx(args);
@@ -0,0 +1,114 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE){
+        return;
+    }
+    _file = file;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size)){
+        _close();
+        return;
+    }
+    _size = static_cast<size_t>(size.QuadPart);
+    _open = true;
+    if(_size == 0){
+        return;
+    }
+
+    _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!_mapping){
+        _close();
+        return;
+    }
+    _data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    if(!_data){
+        _close();
+    }
+}
+
+void MappedFile::_close() {
+    if(_data) UnmapViewOfFile(_data);
+    if(_mapping) CloseHandle(_mapping);
+    if(_file) CloseHandle(_file);
+    _data = nullptr;
+    _mapping = nullptr;
+    _file = nullptr;
+    _size = 0;
+    _open = false;
+}
+#else
+MappedFile::MappedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        return;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)){
+        ::close(fd);
+        return;
+    }
+    _size = static_cast<size_t>(st.st_size);
+    _open = true;
+
+    if(_size > 0){
+        void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED){
+            _size = 0;
+            _open = false;
+        }
+        else{
+            madvise(data, _size, MADV_SEQUENTIAL);
+            _data = static_cast<const char*>(data);
+        }
+    }
+    ::close(fd);
+}
+
+void MappedFile::_close() {
+    if(_data){
+        munmap(const_cast<char*>(_data), _size);
+    }
+    _data = nullptr;
+    _size = 0;
+    _open = false;
+}
+#endif
+
+MappedFile::~MappedFile() {
+    _close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if(this != &other){
+        _close();
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+        std::swap(_open, other._open);
+#ifdef _WIN32
+        std::swap(_file, other._file);
+        std::swap(_mapping, other._mapping);
+#endif
+    }
+    return *this;
+}
@@ -0,0 +1,115 @@
+#include "range_coder.h"
+
+#include <algorithm>
+
+constexpr int PROB_BITS = 11;
+constexpr uint16_t PROB_INIT = 1 << (PROB_BITS - 1);
+constexpr int MOVE_BITS = 5;
+constexpr uint32_t TOP = 1u << 24;
+
+void RangeEncoder::encode(uint16_t& prob, int bit) {
+    uint32_t bound = (_range >> PROB_BITS) * prob;
+    if(bit == 0){
+        _range = bound;
+        prob += ((1 << PROB_BITS) - prob) >> MOVE_BITS;
+    }
+    else{
+        _low += bound;
+        _range -= bound;
+        prob -= prob >> MOVE_BITS;
+    }
+    while(_range < TOP){
+        _range <<= 8;
+        _shiftLow();
+    }
+}
+
+void RangeEncoder::finish() {
+    for(int i = 0; i < 5; ++i){
+        _shiftLow();
+    }
+}
+
+void RangeEncoder::_shiftLow() {
+    // Bytes of 0xFF are held back until it is known whether a carry
+    // propagates into them.
+    if(static_cast<uint32_t>(_low) < 0xFF000000u || (_low >> 32) != 0){
+        uint8_t carry = static_cast<uint8_t>(_low >> 32);
+        uint8_t b = _cache;
+        do {
+            _out.push_back(b + carry);
+            b = 0xFF;
+        } while(--_pending != 0);
+        _cache = static_cast<uint8_t>(_low >> 24);
+    }
+    ++_pending;
+    _low = (_low & 0x00FFFFFF) << 8;
+}
+
+RangeDecoder::RangeDecoder(const uint8_t* data, size_t size) : _p(data), _end(data + size) {
+    for(int i = 0; i < 5; ++i){
+        _code = (_code << 8) | _next();
+    }
+}
+
+int RangeDecoder::decode(uint16_t& prob) {
+    uint32_t bound = (_range >> PROB_BITS) * prob;
+    int bit;
+    if(_code < bound){
+        _range = bound;
+        prob += ((1 << PROB_BITS) - prob) >> MOVE_BITS;
+        bit = 0;
+    }
+    else{
+        _code -= bound;
+        _range -= bound;
+        prob -= prob >> MOVE_BITS;
+        bit = 1;
+    }
+    while(_range < TOP){
+        _range <<= 8;
+        _code = (_code << 8) | _next();
+    }
+    return bit;
+}
+
+uint8_t RangeDecoder::_next() {
+    // A truncated stream decodes as zeros; the symbol counts bound the loop.
+    return _p < _end ? *_p++ : 0;
+}
+
+CLERSModel::CLERSModel() {
+    std::fill(&_probs[0][0], &_probs[0][0] + CONTEXTS * 4, PROB_INIT);
+}
+
+void CLERSModel::encode(RangeEncoder& rc, CLERS s) {
+    auto& p = _probs[_ctx];
+    if(s == CLERS::C){
+        rc.encode(p[0], 0);
+    }
+    else{
+        int second = (s == CLERS::L || s == CLERS::E);
+        int third = (s == CLERS::E || s == CLERS::R);
+        rc.encode(p[0], 1);
+        rc.encode(p[1], second);
+        rc.encode(p[2 + second], third);
+    }
+    _update(s);
+}
+
+CLERS CLERSModel::decode(RangeDecoder& rc) {
+    auto& p = _probs[_ctx];
+    CLERS s = CLERS::C;
+    if(rc.decode(p[0])){
+        int second = rc.decode(p[1]);
+        int third = rc.decode(p[2 + second]);
+        static constexpr CLERS symbols[4] = { CLERS::S, CLERS::R, CLERS::L, CLERS::E };
+        s = symbols[(second << 1) | third];
+    }
+    _update(s);
+    return s;
+}
+
+void CLERSModel::_update(CLERS s) {
+    _ctx = (_ctx % 5) * 5 + static_cast<int>(s);
+}
@@ -0,0 +1,107 @@
+#include "rans.h"
+
+#include <algorithm>
+
+RANSTable::RANSTable(const std::vector<uint32_t>& counts) : _freq(counts.size(), 0) {
+    uint64_t total = 0;
+    for(auto c : counts){
+        total += c;
+    }
+
+    // Every present symbol keeps at least one slot; rounding errors are taken
+    // from, or given to, the most frequent symbol. Counts can exceed 2^20, so
+    // the scaling is done in 64 bits.
+    int64_t assigned = 0;
+    size_t largest = 0;
+    for(size_t s = 0; s < counts.size(); ++s){
+        if(counts[s] == 0) continue;
+        _freq[s] = std::max<uint32_t>(1, static_cast<uint32_t>(uint64_t(counts[s]) * TOTAL / total));
+        assigned += _freq[s];
+        if(counts[s] > counts[largest]) largest = s;
+    }
+    int64_t rest = static_cast<int64_t>(TOTAL) - assigned;
+    while(rest < 0){
+        // Only possible with many rare symbols; shave the largest ones.
+        auto it = std::max_element(_freq.begin(), _freq.end());
+        int64_t take = std::min<int64_t>(-rest, *it - 1);
+        *it -= take;
+        rest += take;
+    }
+    _freq[largest] += rest;
+
+    _finish();
+}
+
+RANSTable::RANSTable(ByteReader& in) {
+    size_t size = in.getCount();
+    _freq.resize(size);
+    uint64_t total = 0;
+    for(auto& f : _freq){
+        f = static_cast<uint32_t>(in.getVarint());
+        total += f;
+    }
+    if(total != TOTAL) throw ReaderException("Invalid rANS frequency table");
+
+    _finish();
+}
+
+void RANSTable::write(ByteWriter& out) const {
+    out.putVarint(_freq.size());
+    for(auto f : _freq){
+        out.putVarint(f);
+    }
+}
+
+void RANSTable::_finish() {
+    _start.resize(_freq.size());
+    _slots.resize(TOTAL);
+    uint32_t start = 0;
+    for(size_t s = 0; s < _freq.size(); ++s){
+        _start[s] = start;
+        for(uint32_t i = 0; i < _freq[s]; ++i){
+            _slots[start + i] = { static_cast<uint16_t>(s), static_cast<uint16_t>(_freq[s]), static_cast<uint16_t>(i), 0 };
+        }
+        start += _freq[s];
+    }
+}
+
+std::vector<uint8_t> ransEncode(
+    const std::vector<uint16_t>& symbols,
+    const std::vector<RANSTable>& tables
+) {
+    std::vector<uint8_t> out;
+    out.reserve(symbols.size() / 2 + 8);
+
+    uint32_t state[2] = { RANSDecoder::LOW, RANSDecoder::LOW };
+    for(size_t i = symbols.size(); i-- > 0;){
+        auto& table = tables[i % tables.size()];
+        uint32_t& x = state[i & 1];
+        int s = symbols[i];
+        uint32_t freq = table.freq(s);
+        uint32_t x_max = ((RANSDecoder::LOW >> RANSTable::PROB_BITS) << 8) * freq;
+        while(x >= x_max){
+            out.push_back(static_cast<uint8_t>(x));
+            x >>= 8;
+        }
+        x = ((x / freq) << RANSTable::PROB_BITS) + (x % freq) + table.start(s);
+    }
+    // Reversed below, so state 0 ends up first.
+    for(int k = 1; k >= 0; --k){
+        for(int i = 0; i < 4; ++i){
+            out.push_back(static_cast<uint8_t>(state[k]));
+            state[k] >>= 8;
+        }
+    }
+
+    std::reverse(out.begin(), out.end());
+    return out;
+}
+
+RANSDecoder::RANSDecoder(const uint8_t* data, size_t size) : _p(data), _end(data + size) {
+    for(int i = 0; i < 4; ++i){
+        _x = (_x << 8) | (_p < _end ? *_p++ : 0);
+    }
+    for(int i = 0; i < 4; ++i){
+        _y = (_y << 8) | (_p < _end ? *_p++ : 0);
+    }
+}
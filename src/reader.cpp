@@ -1,115 +1,663 @@
 #include "reader.h"
+#include "mapped_file.h"
+#include "byte_stream.h"
+#include "bco_format.h"
+#include "range_coder.h"
+#include "residual_coder.h"
+#include "handle_stream.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+#pragma region HELPERS
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
 
-std::pair<std::vector<Vertex>, std::vector<Indices>> Reader::read_OBJ(
-    const std::string& infile
-) {
-    std::ifstream in(infile);
-    if(!in) throw ReaderException(std::format("Cannot open file {}!", infile));
+inline bool isSpace(char c) {
+    return isBlank(c) || c == '\n';
+}
 
-    std::vector<Vertex> vert;
-    std::vector<Indices> tri;
+inline const char* skipBlank(const char* p, const char* end) {
+    while (p < end && isBlank(*p)) ++p;
+    return p;
+}
+
+inline const char* skipSpace(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) ++p;
+    return p;
+}
 
-    std::string line, tag;
-    while (std::getline(in, line)) {
-        std::istringstream ss(line);
-        ss >> tag;
-        if (tag == "v") {
+inline const char* skipLine(const char* p, const char* end) {
+    p = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return p ? p + 1 : end;
+}
+
+// Returns the position after the number, or nullptr if there is none.
+template<typename T>
+const char* parseNumber(const char* p, const char* end, T& value) {
+    if (!p) return nullptr;
+    if (p < end && *p == '+') ++p;
+    auto [ptr, ec] = std::from_chars(p, end, value);
+    return ec == std::errc() ? ptr : nullptr;
+}
+
+inline bool isRecord(const char* p, const char* end, char tag) {
+    return end - p >= 2 && p[0] == tag && isBlank(p[1]);
+}
+
+std::pair<size_t, size_t> countOBJ(
+    const char* p,
+    const char* end
+) {
+    size_t vert_count = 0, face_count = 0;
+    while (p < end) {
+        p = skipBlank(p, end);
+        vert_count += isRecord(p, end, 'v');
+        face_count += isRecord(p, end, 'f');
+        p = skipLine(p, end);
+    }
+    return {vert_count, face_count};
+}
+
+// Parses "v" and "f" records. Face indices are 1-based, or relative to the
+// vertices read so far when negative; texture and normal indices are skipped.
+// Relative indices are resolved against vert.size() and their positions in
+// tri are recorded, so a chunk parsed on its own can be shifted afterwards.
+void parseOBJ(
+    const char* p,
+    const char* end,
+    std::vector<Vertex>& vert,
+    std::vector<Indices>& tri,
+    std::vector<size_t>& relative,
+    const std::string& infile
+) {
+    std::vector<int> indices;
+    std::vector<char> is_relative;
+    while (p < end) {
+        p = skipBlank(p, end);
+        if (isRecord(p, end, 'v')) {
             Vertex v{};
-            ss >> v[0] >> v[1] >> v[2];
+            p += 2;
+            for (int i = 0; i < 3; ++i) {
+                const char* q = parseNumber(skipBlank(p, end), end, v[i]);
+                if (!q) break;
+                p = q;
+            }
             vert.push_back(v);
-        } else if (tag == "f") {
-            std::vector<int> indices;
-            std::string tok;
-            while (ss >> tok)
-                indices.push_back(std::stoi(tok.substr(0, tok.find('/'))) - 1);
+        }
+        else if (isRecord(p, end, 'f')) {
+            p += 2;
+            indices.clear();
+            is_relative.clear();
+            for (;;) {
+                p = skipBlank(p, end);
+                if (p == end || *p == '\n' || *p == '#') break;
+
+                int idx;
+                const char* q = parseNumber(p, end, idx);
+                if (!q || idx == 0) throw ReaderException(std::format("Invalid face in {}!", infile));
+                indices.push_back(idx < 0 ? static_cast<int>(vert.size()) + idx : idx - 1);
+                is_relative.push_back(idx < 0);
+
+                p = q;
+                while (p < end && !isSpace(*p)) ++p;
+            }
 
             if (indices.size() < 3) continue;
 
-            for (size_t i = 1; i + 1 < indices.size(); ++i)
+            for (size_t i = 1; i + 1 < indices.size(); ++i) {
+                size_t corners[3] = { 0, i, i + 1 };
+                for (int k = 0; k < 3; ++k) {
+                    if (is_relative[corners[k]]) relative.push_back(tri.size() * 3 + k);
+                }
                 tri.push_back({ indices[0], indices[i], indices[i + 1] });
+            }
         }
+        p = skipLine(p, end);
+    }
+}
+
+// Below this size the file is parsed on the calling thread.
+constexpr size_t PARALLEL_OBJ_BYTES = 1 << 22;
+
+std::pair<std::vector<Vertex>, std::vector<Indices>> parseOBJParallel(
+    const char* begin,
+    const char* end,
+    ThreadPool* pool,
+    const std::string& infile
+) {
+    // Chunk boundaries are moved forward to the next line start.
+    size_t chunks = pool->size() * 4;
+    size_t size = end - begin;
+    std::vector<const char*> bounds = { begin };
+    for (size_t i = 1; i < chunks; ++i) {
+        const char* p = std::max(begin + size * i / chunks, bounds.back());
+        p = p == begin ? p : skipLine(p - 1, end);
+        bounds.push_back(p);
+    }
+    bounds.push_back(end);
+
+    std::vector<std::vector<Vertex>> chunk_vert(chunks);
+    std::vector<std::vector<Indices>> chunk_tri(chunks);
+    std::vector<std::vector<size_t>> chunk_relative(chunks);
+    parallelFor(pool, chunks, [&](size_t i){
+        auto [vert_count, face_count] = countOBJ(bounds[i], bounds[i + 1]);
+        chunk_vert[i].reserve(vert_count);
+        chunk_tri[i].reserve(face_count);
+        parseOBJ(bounds[i], bounds[i + 1], chunk_vert[i], chunk_tri[i], chunk_relative[i], infile);
+    });
+
+    std::vector<size_t> vert_offset(chunks + 1, 0), tri_offset(chunks + 1, 0);
+    for (size_t i = 0; i < chunks; ++i) {
+        vert_offset[i + 1] = vert_offset[i] + chunk_vert[i].size();
+        tri_offset[i + 1] = tri_offset[i] + chunk_tri[i].size();
     }
 
-    return std::make_pair(vert, tri);
+    std::vector<Vertex> vert(vert_offset[chunks]);
+    std::vector<Indices> tri(tri_offset[chunks]);
+    parallelFor(pool, chunks, [&](size_t i){
+        // Relative indices were resolved against the chunk's own vertices.
+        int shift = static_cast<int>(vert_offset[i]);
+        for (size_t r : chunk_relative[i]) {
+            chunk_tri[i][r / 3][r % 3] += shift;
+        }
+        std::copy(chunk_vert[i].begin(), chunk_vert[i].end(), vert.begin() + vert_offset[i]);
+        std::copy(chunk_tri[i].begin(), chunk_tri[i].end(), tri.begin() + tri_offset[i]);
+        std::vector<Vertex>().swap(chunk_vert[i]);
+        std::vector<Indices>().swap(chunk_tri[i]);
+    });
+
+    return std::make_pair(std::move(vert), std::move(tri));
 }
 
-std::pair<std::vector<Vertex>, std::vector<Indices>> Reader::read_OFF(
+// Every symbol that starts and ends within one byte of the CLERS prefix
+// code, so unpacking can take a byte at a time instead of a bit.
+struct CLERSByteTable {
+    struct Entry {
+        CLERS symbols[8] = {};
+        uint8_t count = 0;
+        uint8_t bits = 0;
+    };
+    Entry entries[256];
+
+    constexpr CLERSByteTable() {
+        for (int byte = 0; byte < 256; ++byte) {
+            auto& e = entries[byte];
+            int pos = 7;
+            while (pos >= 0) {
+                if (((byte >> pos) & 1) == 0) {
+                    e.symbols[e.count++] = CLERS::C;
+                    pos -= 1;
+                    continue;
+                }
+                if (pos < 2) break;
+                constexpr CLERS tail[4] = { CLERS::S, CLERS::R, CLERS::L, CLERS::E };
+                e.symbols[e.count++] = tail[(byte >> (pos - 2)) & 0b11];
+                pos -= 3;
+            }
+            e.bits = static_cast<uint8_t>(7 - pos);
+        }
+    }
+};
+
+// Prefix code C=0, L=110, E=111, R=101, S=100, packed MSB first.
+void unpackCLERS(
+    const uint8_t* data,
+    size_t size,
+    size_t count,
+    std::vector<CLERS>& clers
+) {
+    static constexpr CLERSByteTable table;
+
+    // Every symbol takes at least one bit, so a larger count is corrupt and
+    // must not reach the allocation below.
+    if (count > size * 8) throw ReaderException("Truncated CLERS stream");
+
+    // Up to 8 symbols are stored per step, so keep room past the end.
+    clers.resize(count + 8);
+    CLERS* out = clers.data();
+    CLERS* end = out + count;
+
+    const uint8_t* p = data;
+    const uint8_t* data_end = data + size;
+    uint64_t bit_buffer = 0;
+    int bit_count = 0;
+    size_t consumed = 0;
+    while (out < end) {
+        if (bit_count < 8) {
+            // Past the end zeros are read; the total is checked below.
+            while (bit_count <= 56) {
+                bit_buffer = (bit_buffer << 8) | (p < data_end ? *p++ : 0);
+                bit_count += 8;
+            }
+        }
+        auto& e = table.entries[(bit_buffer >> (bit_count - 8)) & 0xff];
+        std::memcpy(out, e.symbols, sizeof(e.symbols));
+        out += e.count;
+        bit_count -= e.bits;
+        consumed += e.bits;
+    }
+
+    // The last step may have gone past count; give back the extra bits.
+    for (; out > end; --out) {
+        consumed -= out[-1] == CLERS::C ? 1 : 3;
+    }
+    if (consumed > size * 8) throw ReaderException("Truncated CLERS stream");
+    clers.resize(count);
+}
+
+void decodeCLERS(
+    const uint8_t* data,
+    size_t size,
+    size_t count,
+    std::vector<CLERS>& clers
+) {
+    // A symbol costs at least ~0.022 bits (the highest probability is
+    // 2017/2048), so no valid stream holds more than ~360 symbols per byte.
+    if (count / 512 > size + 8) throw ReaderException("Invalid CLERS stream");
+
+    clers.clear();
+    clers.reserve(count);
+
+    RangeDecoder rc(data, size);
+    CLERSModel model;
+    for (size_t j = 0; j < count; ++j) {
+        clers.push_back(model.decode(rc));
+    }
+}
+
+void getRawVertices(
+    ByteReader& in,
+    size_t count,
+    bool quantized,
+    std::deque<Vertex>& vertices
+) {
+    if (quantized) {
+        if (count > in.remaining() / 3) throw ReaderException("Invalid count in compressed data");
+        vertices.resize(count);
+        for (auto& v : vertices) {
+            v[0] = static_cast<float>(in.getSigned());
+            v[1] = static_cast<float>(in.getSigned());
+            v[2] = static_cast<float>(in.getSigned());
+        }
+    }
+    else {
+        if (count > in.remaining() / sizeof(Vertex)) throw ReaderException("Invalid count in compressed data");
+        auto v = reinterpret_cast<const Vertex*>(in.take(count * sizeof(Vertex)));
+        vertices.assign(v, v + count);
+    }
+}
+
+struct BCOHeader {
+    Quantization quant;
+    bool quantized = false;
+    bool arithmetic = false;
+    bool rans_vertices = false;
+};
+
+BCOHeader readBCOHeader(
+    ByteReader& in,
     const std::string& infile
 ) {
-    std::ifstream in(infile);
+    if (in.remaining() < sizeof(BCOFormat::MAGIC) + 4 ||
+        std::memcmp(in.take(sizeof(BCOFormat::MAGIC)), BCOFormat::MAGIC, sizeof(BCOFormat::MAGIC)) != 0) {
+        throw ReaderException(std::format("{} is not a BCO file!", infile));
+    }
+    uint8_t version = in.getByte();
+    if (version != BCOFormat::VERSION) {
+        throw ReaderException(std::format("Unsupported BCO version {} in {}!", version, infile));
+    }
+    uint8_t flags = in.getByte();
+    uint16_t endian;
+    std::memcpy(&endian, in.take(sizeof(endian)), sizeof(endian));
+    if (endian != BCOFormat::ENDIAN) {
+        throw ReaderException(std::format("BCO file {} was written with a different byte order!", infile));
+    }
+
+    BCOHeader header;
+    header.quantized = flags & BCOFormat::QUANTIZED;
+    header.arithmetic = flags & BCOFormat::ARITHMETIC_CLERS;
+    header.rans_vertices = flags & BCOFormat::RANS_VERTICES;
+    if (header.quantized) {
+        auto& quant = header.quant;
+        quant.bits = in.getByte();
+        std::memcpy(quant.min.data(), in.take(sizeof(quant.min)), sizeof(quant.min));
+        std::memcpy(&quant.step, in.take(sizeof(quant.step)), sizeof(quant.step));
+        if (quant.bits < 1 || quant.bits > 22) {
+            throw ReaderException(std::format("Invalid quantization in {}!", infile));
+        }
+    }
+    return header;
+}
+
+void readBCOComponent(
+    ByteReader& in,
+    const BCOHeader& header,
+    std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>& component
+) {
+    auto& [vertices, clers, handles, dummy] = component;
+
+    size_t vertices_size = in.getVarint();
+    std::deque<Vertex> v;
+    if (header.rans_vertices && in.getByte()) {
+        decodeResiduals(in, vertices_size, header.quantized, v);
+    }
+    else {
+        getRawVertices(in, vertices_size, header.quantized, v);
+    }
+    vertices = std::queue<Vertex>(std::move(v));
+
+    size_t clers_size = in.getVarint();
+    // The first vertex loop has at least two edges and one vertex per edge;
+    // the decompressor sizes its tables from it, so it is checked here.
+    int64_t first = in.getSigned();
+    if (first < 2 || static_cast<uint64_t>(first) > vertices_size) throw ReaderException("Invalid CLERS string");
+    clers.first = static_cast<int>(first);
+    size_t packed_size = in.getCount();
+    if (header.arithmetic) {
+        decodeCLERS(in.take(packed_size), packed_size, clers_size, clers.second);
+    }
+    else {
+        unpackCLERS(in.take(packed_size), packed_size, clers_size, clers.second);
+    }
+
+    // Kept delta coded; the decompressor reads them with a HandleCursor.
+    handles.count = in.getVarint();
+    if (handles.count > 0) {
+        size_t handles_bytes = in.getCount();
+        if (handles.count > handles_bytes / 2) throw ReaderException("Invalid handle count");
+        auto handles_data = in.take(handles_bytes);
+        handles.data.assign(handles_data, handles_data + handles_bytes);
+    }
+
+    size_t dummy_size = in.getCount();
+    dummy.resize(dummy_size);
+    for (auto& d : dummy) {
+        d.first = static_cast<int>(in.getVarint());
+    }
+}
+
+// The index offset and entries, found through the footer at the end of the
+// file. Entries are not aligned in the mapping, so they are copied out.
+std::pair<size_t, std::vector<BCOFormat::IndexEntry>> readBCOIndex(
+    const uint8_t* data,
+    size_t size,
+    size_t components,
+    const std::string& infile
+) {
+    BCOFormat::Footer footer;
+    if (size < sizeof(footer)) throw ReaderException(std::format("{} has no component index!", infile));
+    std::memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+    if (std::memcmp(footer.magic, BCOFormat::INDEX_MAGIC, sizeof(BCOFormat::INDEX_MAGIC)) != 0) {
+        throw ReaderException(std::format("{} has no component index!", infile));
+    }
+    size_t index_end = size - sizeof(footer);
+    if (footer.components != components ||
+        footer.index_offset > index_end ||
+        index_end - footer.index_offset != components * sizeof(BCOFormat::IndexEntry)) {
+        throw ReaderException(std::format("Invalid component index in {}!", infile));
+    }
+
+    std::vector<BCOFormat::IndexEntry> index(components);
+    std::memcpy(index.data(), data + footer.index_offset, components * sizeof(BCOFormat::IndexEntry));
+    return { footer.index_offset, std::move(index) };
+}
+
+std::vector<ComponentInfo> toComponentInfo(
+    const std::vector<BCOFormat::IndexEntry>& index
+) {
+    std::vector<ComponentInfo> info(index.size());
+    for (size_t i = 0; i < index.size(); ++i) {
+        auto& entry = index[i];
+        info[i].triangles = entry.triangles;
+        info[i].vertices = entry.vertices;
+        std::copy(std::begin(entry.min), std::end(entry.min), info[i].min.begin());
+        std::copy(std::begin(entry.max), std::end(entry.max), info[i].max.begin());
+    }
+    return info;
+}
+
+std::pair<Quantization, std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>>> readBCO(
+    const uint8_t* data,
+    size_t size,
+    const std::string& infile
+) {
+    ByteReader in(data, size);
+    auto header = readBCOHeader(in, infile);
+
+    std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>> decompressed;
+
+    size_t comp_size = in.getCount();
+    decompressed.reserve(comp_size);
+    for (size_t i = 0; i < comp_size; ++i) {
+        readBCOComponent(in, header, decompressed.emplace_back());
+    }
+    return std::make_pair(header.quant, std::move(decompressed));
+}
+
+std::pair<Quantization, std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>>> readBCOComponents(
+    const uint8_t* data,
+    size_t size,
+    const std::vector<size_t>& components,
+    const std::string& infile,
+    std::vector<ComponentInfo>* info
+) {
+    ByteReader in(data, size);
+    auto header = readBCOHeader(in, infile);
+    auto [end, index] = readBCOIndex(data, size, in.getCount(), infile);
+    if (info) *info = toComponentInfo(index);
+
+    // Components start past the header and end before the index, so every
+    // entry is checked against that range before it is used.
+    size_t begin = in.position() - data;
+
+    std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>> decompressed;
+    decompressed.reserve(components.size());
+    for (auto i : components) {
+        if (i >= index.size()) {
+            throw ReaderException(std::format("{} has no component {}!", infile, i));
+        }
+        auto& entry = index[i];
+        if (entry.offset < begin || entry.offset > end || entry.size > end - entry.offset) {
+            throw ReaderException(std::format("Invalid component index in {}!", infile));
+        }
+        ByteReader component(data + entry.offset, entry.size);
+        readBCOComponent(component, header, decompressed.emplace_back());
+        if (component.remaining() != 0) {
+            throw ReaderException(std::format("Invalid component index in {}!", infile));
+        }
+    }
+    return std::make_pair(header.quant, std::move(decompressed));
+}
+
+#pragma endregion
+
+std::pair<std::vector<Vertex>, std::vector<Indices>> Reader::read_OBJ(
+    const std::string& infile,
+    ThreadPool* pool
+) {
+    std::vector<Vertex> vert;
+    std::vector<Indices> tri;
+    read_OBJ(infile, vert, tri, pool);
+    return std::make_pair(std::move(vert), std::move(tri));
+}
+
+void Reader::read_OBJ(
+    const std::string& infile,
+    std::vector<Vertex>& vert,
+    std::vector<Indices>& tri,
+    ThreadPool* pool
+) {
+    MappedFile in(infile);
     if(!in) throw ReaderException(std::format("Cannot open file {}!", infile));
 
+    const char* begin = in.data();
+    const char* end = begin + in.size();
+
+    if (pool && pool->size() > 1 && in.size() >= PARALLEL_OBJ_BYTES) {
+        std::tie(vert, tri) = parseOBJParallel(begin, end, pool, infile);
+        return;
+    }
+
+    std::vector<size_t> relative;
+
+    auto [vert_count, face_count] = countOBJ(begin, end);
+    vert.clear();
+    tri.clear();
+    vert.reserve(vert_count);
+    tri.reserve(face_count);
+
+    parseOBJ(begin, end, vert, tri, relative, infile);
+}
+
+std::pair<std::vector<Vertex>, std::vector<Indices>> Reader::read_OFF(
+    const std::string& infile
+) {
     std::vector<Vertex> vert;
     std::vector<Indices> tri;
+    read_OFF(infile, vert, tri);
+    return std::make_pair(std::move(vert), std::move(tri));
+}
 
-    std::string header;
-    in >> header;
-    if (header != "OFF") throw ReaderException("Invalid OFF file");
+void Reader::read_OFF(
+    const std::string& infile,
+    std::vector<Vertex>& vert,
+    std::vector<Indices>& tri
+) {
+    MappedFile in(infile);
+    if(!in) throw ReaderException(std::format("Cannot open file {}!", infile));
+
+    const char* p = in.data();
+    const char* end = p + in.size();
+
+    p = skipSpace(p, end);
+    if (end - p < 3 || std::string_view(p, 3) != "OFF" || (end - p > 3 && !isSpace(p[3]))) {
+        throw ReaderException("Invalid OFF file");
+    }
+    p += 3;
 
     int numVerts, numFaces, _;
-    in >> numVerts >> numFaces >> _;
+    if (!(p = parseNumber(skipSpace(p, end), end, numVerts)) ||
+        !(p = parseNumber(skipSpace(p, end), end, numFaces)) ||
+        !(p = parseNumber(skipSpace(p, end), end, _)) ||
+        numVerts < 0 || numFaces < 0
+    ) {
+        throw ReaderException("Invalid OFF file");
+    }
 
     vert.resize(numVerts);
-    for (auto& v : vert)
-        in >> v[0] >> v[1] >> v[2];
+    for (auto& v : vert) {
+        for (int i = 0; i < 3; ++i) {
+            if (!(p = parseNumber(skipSpace(p, end), end, v[i]))) {
+                throw ReaderException("Invalid OFF file");
+            }
+        }
+    }
 
+    tri.clear();
+    tri.reserve(numFaces);
+    std::vector<int> indices;
     for (int i = 0; i < numFaces; ++i) {
-        int n; in >> n;
-        std::vector<int> indices(n);
-        for (int& idx : indices) in >> idx;
+        int n;
+        if (!(p = parseNumber(skipSpace(p, end), end, n)) || n < 0) {
+            throw ReaderException("Invalid OFF file");
+        }
+        indices.resize(n);
+        for (int& idx : indices) {
+            if (!(p = parseNumber(skipSpace(p, end), end, idx))) {
+                throw ReaderException("Invalid OFF file");
+            }
+        }
 
         for (int j = 1; j + 1 < n; ++j)
             tri.push_back({ indices[0], indices[j], indices[j + 1] });
-    }
 
-    return std::make_pair(vert, tri);
+        // Per-face colors and the like are ignored.
+        p = skipLine(p, end);
+    }
 }
 
-std::pair<std::vector<Vertex>, std::vector<std::tuple<std::vector<int>, std::vector<int>, std::vector<Dummy>>>> Reader::read_OVX(
+MappedOVX Reader::read_OVX(
     const std::string& infile
 ) {
-    std::ifstream in(infile);
-    if(!in) throw ReaderException(std::format("Cannot open file {}!", infile));
+    MappedOVX result;
+    result.file = MappedFile(infile);
+    if(!result.file) throw ReaderException(std::format("Cannot open file {}!", infile));
 
-    std::vector<Vertex> vert;
-    std::vector<std::tuple<std::vector<int>, std::vector<int>, std::vector<Dummy>>> ovx;
+    const char* data = result.file.data();
+    uint64_t size = result.file.size();
 
-    int comp_size;
-    in >> comp_size;
-    for(int i = 0; i < comp_size; ++i){
-        auto& [V, O, dummy] = ovx.emplace_back();
-
-        int vo_size, v, o;
-        in >> vo_size;
-        for(int j = 0; j < 3 * vo_size; ++j){
-            in >> v >> o;
-            V.push_back(v); //TODO remove
-            O.push_back(o);
+    OVXFormat::Header header;
+    if(size < sizeof(header)) throw ReaderException(std::format("Invalid OVX file {}!", infile));
+    std::memcpy(&header, data, sizeof(header));
+
+    if(std::memcmp(header.magic, OVXFormat::MAGIC, sizeof(header.magic)) != 0){
+        throw ReaderException(std::format("Invalid OVX file {}! Regenerate it with the ovx mode.", infile));
+    }
+    if(header.version != OVXFormat::VERSION){
+        throw ReaderException(std::format("Unsupported OVX version {} in {}!", header.version, infile));
+    }
+    if(header.endian != OVXFormat::ENDIAN){
+        throw ReaderException(std::format("OVX file {} was written with a different byte order!", infile));
+    }
+
+    auto section = [&](uint64_t offset, uint64_t count, uint64_t element){
+        if(offset % OVXFormat::ALIGNMENT != 0 || offset > size || count > (size - offset) / element){
+            throw ReaderException(std::format("Invalid OVX file {}!", infile));
         }
-        int dummy_size;
-        in >> dummy_size;
-        dummy.resize(dummy_size);
-        for(auto& d : dummy){
-            in >> d.first;
+        return data + offset;
+    };
+
+    auto table = reinterpret_cast<const OVXFormat::Component*>(section(header.table_offset, header.components, sizeof(OVXFormat::Component)));
+    auto V = reinterpret_cast<const int*>(section(header.V_offset, header.corners, sizeof(int32_t)));
+    auto O = reinterpret_cast<const int*>(section(header.O_offset, header.corners, sizeof(int32_t)));
+    auto dummy = reinterpret_cast<const int*>(section(header.dummy_offset, header.dummies, sizeof(int32_t)));
+    auto vert = reinterpret_cast<const Vertex*>(section(header.vert_offset, header.vertices, sizeof(Vertex)));
+
+    result.vert = std::span<const Vertex>(vert, header.vertices);
+    result.ovx.reserve(header.components);
+    for(uint64_t i = 0; i < header.components; ++i){
+        auto& c = table[i];
+        if(c.corner_offset > header.corners || c.corner_count > header.corners - c.corner_offset ||
+           c.dummy_offset > header.dummies || c.dummy_count > header.dummies - c.dummy_offset){
+            throw ReaderException(std::format("Invalid OVX file {}!", infile));
+        }
+
+        // The compressor indexes straight into the mapping, so every entry
+        // has to point into the vertex array or into its own component.
+        bool valid = c.corner_count % 3 == 0;
+        for(uint64_t j = c.corner_offset; valid && j < c.corner_offset + c.corner_count; ++j){
+            valid = V[j] >= 0 && static_cast<uint64_t>(V[j]) < header.vertices &&
+                    O[j] >= 0 && static_cast<uint64_t>(O[j]) < c.corner_count;
+        }
+        for(uint64_t j = c.dummy_offset; valid && j < c.dummy_offset + c.dummy_count; ++j){
+            valid = dummy[j] >= 0 && static_cast<uint64_t>(dummy[j]) < header.vertices;
+        }
+        if(!valid) throw ReaderException(std::format("Invalid OVX file {}!", infile));
+
+        auto& [_V, _O, _dummy] = result.ovx.emplace_back();
+        _V = std::span<const int>(V + c.corner_offset, c.corner_count);
+        _O = std::span<const int>(O + c.corner_offset, c.corner_count);
+        _dummy.resize(c.dummy_count);
+        for(uint64_t j = 0; j < c.dummy_count; ++j){
+            _dummy[j].first = dummy[c.dummy_offset + j];
         }
-    }
-    int vert_size;
-    in >> vert_size;
-    vert.resize(vert_size);
-    for(auto& v : vert){
-        in >> v[0] >> v[1] >> v[2];
     }
 
-    return std::make_pair(vert, ovx);
+    return result;
 }
 
-std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>> Reader::read_Compressed(
+std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>> Reader::read_Compressed(
     const std::string &infile
 ) {
     std::ifstream in(infile);
     if(!in) throw ReaderException(std::format("Cannot open file {}!", infile));
 
-    std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>> decompressed;
+    std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>> decompressed;
 
     int comp_size;
     in >> comp_size;
@@ -124,6 +672,7 @@ std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, s
         }
         int clers_size;
         in >> clers_size >> clers.first;
+        if(!in || clers.first < 2 || clers.first > vertices_size) throw ReaderException("Invalid CLERS string");
         for(int j = 0; j < clers_size; ++j){
             char ch;
             in >> ch;
@@ -146,12 +695,17 @@ std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, s
                 break;
             }
         }
-        int handles_size, a, b;
+        int handles_size;
         in >> handles_size;
+        std::vector<Handle> _handles(std::max(handles_size, 0));
         for(int j = 0; j < handles_size; ++j){
-            Handle& h = handles.emplace_back();
+            auto& h = _handles[j];
             in >> h[0] >> h[1];
+            if(h[0] < 0 || h[0] >= h[1] || (j > 0 && h[1] <= _handles[j - 1][1])){
+                throw ReaderException(std::format("Invalid handle in {}!", infile));
+            }
         }
+        handles = encodeHandles(_handles);
         int dummy_size, d;
         in >> dummy_size;
         for(int j = 0; j < dummy_size; ++j){
@@ -165,111 +719,35 @@ std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, s
 
 
 
-std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>> Reader::read_Compressed_BIN(
+std::pair<Quantization, std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>>> Reader::read_Compressed_BIN(
     const std::string &infile
 ) {
-    std::ifstream in(infile, std::ios::binary);
-    if (!in) throw ReaderException(std::format("Cannot open file {}!", infile));
-
-    std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>> decompressed;
-
-    size_t comp_size;
-    in.read(reinterpret_cast<char*>(&comp_size), sizeof(comp_size));
-
-    for (size_t i = 0; i < comp_size; ++i) {
-        auto& [vertices, clers, handles, dummy] = decompressed.emplace_back();
+    MappedFile file(infile);
+    if (!file) throw ReaderException(std::format("Cannot open file {}!", infile));
 
-        // Read vertices count and each Vertex
-        size_t vertices_size;
-        in.read(reinterpret_cast<char*>(&vertices_size), sizeof(vertices_size));
-        for (size_t j = 0; j < vertices_size; ++j) {
-            Vertex v;
-            in.read(reinterpret_cast<char*>(&v[0]), sizeof(v[0]));
-            in.read(reinterpret_cast<char*>(&v[1]), sizeof(v[1]));
-            in.read(reinterpret_cast<char*>(&v[2]), sizeof(v[2]));
-            vertices.push(v);
-        }
-
-        // Read CLERS count and the integer part (clers.first)
-        size_t clers_enum_size;
-        in.read(reinterpret_cast<char*>(&clers_enum_size), sizeof(clers_enum_size));
-        in.read(reinterpret_cast<char*>(&clers.first), sizeof(clers.first));
-        clers.second.clear();
-
-        if (clers_enum_size > 0) {
-            uint8_t current_byte = 0;
-            int current_bit_pos = -1; // Initialize to trigger read on first access
-
-            for (size_t j = 0; j < clers_enum_size; ++j) {
-                // Read first bit
-                if (current_bit_pos < 0) {
-                    in.read(reinterpret_cast<char*>(&current_byte), sizeof(current_byte));
-                    current_bit_pos = 7; // Start at the highest bit
-                }
-
-                int first_bit = (current_byte >> current_bit_pos) & 1;
-                current_bit_pos--;
-
-                if (first_bit == 0) {
-                    clers.second.push_back(CLERS::C);
-                    continue;
-                }
+    return readBCO(reinterpret_cast<const uint8_t*>(file.data()), file.size(), infile);
+}
 
-                // Read second bit
-                if (current_bit_pos < 0) {
-                    in.read(reinterpret_cast<char*>(&current_byte), sizeof(current_byte));
-                    current_bit_pos = 7;
-                }
-                int second_bit = (current_byte >> current_bit_pos) & 1;
-                current_bit_pos--;
+std::pair<Quantization, std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>>> Reader::read_Compressed_BIN(
+    const std::string &infile,
+    const std::vector<size_t>& components,
+    std::vector<ComponentInfo>* index
+) {
+    MappedFile file(infile);
+    if (!file) throw ReaderException(std::format("Cannot open file {}!", infile));
 
-                // Read third bit
-                if (current_bit_pos < 0) {
-                    in.read(reinterpret_cast<char*>(&current_byte), sizeof(current_byte));
-                    current_bit_pos = 7;
-                }
-                int third_bit = (current_byte >> current_bit_pos) & 1;
-                current_bit_pos--;
-
-                uint8_t code = (first_bit << 2) | (second_bit << 1) | third_bit;
-
-                switch (code) {
-                    case 0b110:
-                        clers.second.push_back(CLERS::L);
-                        break;
-                    case 0b111:
-                        clers.second.push_back(CLERS::E);
-                        break;
-                    case 0b101:
-                        clers.second.push_back(CLERS::R);
-                        break;
-                    case 0b100:
-                        clers.second.push_back(CLERS::S);
-                        break;
-                    default:
-                        throw ReaderException("Invalid CLERS code");
-                }
-            }
-        }
+    return readBCOComponents(reinterpret_cast<const uint8_t*>(file.data()), file.size(), components, infile, index);
+}
 
-        // Read handles count and each handle
-        size_t handles_size;
-        in.read(reinterpret_cast<char*>(&handles_size), sizeof(handles_size));
-        for (size_t j = 0; j < handles_size; ++j) {
-            Handle h;
-            in.read(reinterpret_cast<char*>(&h[0]), sizeof(h[0]));
-            in.read(reinterpret_cast<char*>(&h[1]), sizeof(h[1]));
-            handles.push_back(h);
-        }
+std::pair<Quantization, std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>>> Reader::read_Compressed_BIN(
+    std::span<const uint8_t> data
+) {
+    return readBCO(data.data(), data.size(), "BCO buffer");
+}
 
-        // Read dummy count and each dummy
-        size_t dummy_size;
-        in.read(reinterpret_cast<char*>(&dummy_size), sizeof(dummy_size));
-        for (size_t j = 0; j < dummy_size; ++j) {
-            int d;
-            in.read(reinterpret_cast<char*>(&d), sizeof(d));
-            dummy.push_back({d, {}}); // Adjust according to Dummy's structure
-        }
-    }
-    return decompressed;
-}
\ No newline at end of file
+std::pair<Quantization, std::vector<std::tuple<std::queue<Vertex>, std::pair<int, std::vector<CLERS>>, HandleStream, std::vector<Dummy>>>> Reader::read_Compressed_BIN(
+    std::span<const uint8_t> data,
+    const std::vector<size_t>& components
+) {
+    return readBCOComponents(data.data(), data.size(), components, "BCO buffer", nullptr);
+}
@@ -0,0 +1,103 @@
+#include "residual_coder.h"
+#include "rans.h"
+
+#include <bit>
+#include <cstdint>
+
+constexpr int QUANTIZED_BUCKETS = 25;
+constexpr int FLOAT_BUCKETS = 512;
+constexpr int MANTISSA_BITS = 23;
+
+void encodeResiduals(
+    const std::vector<Vertex>& vertices,
+    bool quantized,
+    ByteWriter& out
+) {
+    int buckets = quantized ? QUANTIZED_BUCKETS : FLOAT_BUCKETS;
+    std::vector<uint16_t> symbols(3 * vertices.size());
+    std::vector<std::vector<uint32_t>> counts(3, std::vector<uint32_t>(buckets, 0));
+    BitWriter bits;
+
+    for(size_t i = 0; i < vertices.size(); ++i){
+        for(int k = 0; k < 3; ++k){
+            uint16_t s;
+            if(quantized){
+                int64_t r = static_cast<int64_t>(vertices[i][k]);
+                uint64_t m = r < 0 ? -r : r;
+                s = static_cast<uint16_t>(std::bit_width(m));
+                // Sign on top of the bits below the leading one.
+                if(s > 0){
+                    bits.put((static_cast<uint32_t>(r < 0) << (s - 1)) | (static_cast<uint32_t>(m) & ((1u << (s - 1)) - 1)), s);
+                }
+            }
+            else{
+                uint32_t f = std::bit_cast<uint32_t>(vertices[i][k]);
+                s = static_cast<uint16_t>(f >> MANTISSA_BITS);
+                bits.put(f, MANTISSA_BITS);
+            }
+            symbols[3 * i + k] = s;
+            ++counts[k][s];
+        }
+    }
+
+    // Trailing empty buckets are not stored.
+    std::vector<RANSTable> tables;
+    for(auto& c : counts){
+        while(c.size() > 1 && c.back() == 0){
+            c.pop_back();
+        }
+        tables.emplace_back(c);
+        tables.back().write(out);
+    }
+
+    auto coded = ransEncode(symbols, tables);
+    out.putVarint(coded.size());
+    out.put(coded.data(), coded.size());
+
+    auto& raw = bits.finish();
+    out.putVarint(raw.size());
+    out.put(raw.data(), raw.size());
+}
+
+void decodeResiduals(
+    ByteReader& in,
+    size_t count,
+    bool quantized,
+    std::deque<Vertex>& vertices
+) {
+    RANSTable tables[3] = { RANSTable(in), RANSTable(in), RANSTable(in) };
+    int buckets = quantized ? QUANTIZED_BUCKETS : FLOAT_BUCKETS;
+    for(auto& t : tables){
+        if(t.size() > static_cast<size_t>(buckets)) throw ReaderException("Invalid residual table");
+    }
+
+    size_t coded_size = in.getCount();
+    RANSDecoder rans(in.take(coded_size), coded_size);
+    size_t raw_size = in.getCount();
+    BitReader bits(in.take(raw_size), raw_size);
+
+    // With 12-bit frequencies a symbol costs at least 1/2839 of a bit.
+    if (count / 1024 > coded_size + raw_size + 8) throw ReaderException("Invalid residual stream");
+
+    vertices.resize(count);
+    for(auto& v : vertices){
+        for(int k = 0; k < 3; ++k){
+            int s = rans.decode(tables[k]);
+            if(quantized){
+                // lead is the sign bit as read and the leading one of |r|,
+                // and 0 for a zero residual.
+                // Residuals are below 2^24, and the sign is applied
+                // arithmetically since it is a coin flip for a branch.
+                uint32_t x = bits.get(s);
+                int32_t lead = (1 << s) >> 1;
+                int32_t m = lead | (x & (lead - 1));
+                int32_t negative = -static_cast<int32_t>((x & lead) != 0);
+                v[k] = static_cast<float>((m ^ negative) - negative);
+            }
+            else{
+                uint32_t f = (static_cast<uint32_t>(s) << MANTISSA_BITS) | bits.get(MANTISSA_BITS);
+                v[k] = std::bit_cast<float>(f);
+            }
+        }
+    }
+}
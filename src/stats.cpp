@@ -0,0 +1,125 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <format>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#pragma region HELPERS
+
+std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+#pragma endregion
+
+void Stats::add(const std::string& stage, double ms) {
+    for (auto& [name, total] : _stages) {
+        if (name == stage) {
+            total += ms;
+            return;
+        }
+    }
+    _stages.emplace_back(stage, ms);
+}
+
+void Stats::files(const std::string& infile, size_t infile_bytes, const std::string& outfile, size_t outfile_bytes) {
+    _infile = infile;
+    _infile_bytes = infile_bytes;
+    _outfile = outfile;
+    _outfile_bytes = outfile_bytes;
+}
+
+void Stats::sizes(const BCOSizes& sizes) {
+    _sizes = sizes;
+    _has_sizes = true;
+}
+
+void Stats::write(std::ostream& out) const {
+    static constexpr const char* CLERS_NAMES[5] = { "C", "L", "E", "R", "S" };
+    static constexpr const char* CASE_NAMES[PREDICTION_CASES] = { "ABD", "AD", "AB", "A", "B", "NONE" };
+
+    ComponentStats total;
+    for (auto& c : _components) {
+        total.triangles += c.triangles;
+        total.vertices += c.vertices;
+        total.dummies += c.dummies;
+        total.handles += c.handles;
+        for (size_t i = 0; i < c.clers.size(); ++i) total.clers[i] += c.clers[i];
+        for (size_t i = 0; i < c.prediction.size(); ++i) total.prediction[i] += c.prediction[i];
+    }
+
+    double total_ms = 0;
+    out << "{\n";
+    out << std::format("  \"mode\": {},\n", jsonString(_mode));
+    out << std::format("  \"input\": {{ \"file\": {}, \"bytes\": {} }},\n", jsonString(_infile), _infile_bytes);
+    out << std::format("  \"output\": {{ \"file\": {}, \"bytes\": {} }},\n", jsonString(_outfile), _outfile_bytes);
+    out << "  \"stages_ms\": {";
+    for (size_t i = 0; i < _stages.size(); ++i) {
+        out << std::format("{} {}: {:.3f}", i ? "," : "", jsonString(_stages[i].first), _stages[i].second);
+        total_ms += _stages[i].second;
+    }
+    out << " },\n";
+    out << std::format("  \"total_ms\": {:.3f},\n", total_ms);
+    out << std::format("  \"peak_rss_bytes\": {},\n", peakRSS());
+
+    out << std::format("  \"components\": {},\n  \"triangles\": {},\n  \"vertices\": {},\n  \"dummies\": {},\n  \"handles\": {},\n",
+        _components.size(), total.triangles, total.vertices, total.dummies, total.handles);
+    out << "  \"clers\": {";
+    for (size_t i = 0; i < total.clers.size(); ++i) {
+        out << std::format("{} \"{}\": {}", i ? "," : "", CLERS_NAMES[i], total.clers[i]);
+    }
+    out << " },\n";
+    out << std::format("  \"s_count\": {},\n", total.clers[static_cast<size_t>(CLERS::S)]);
+    out << "  \"prediction_cases\": {";
+    for (size_t i = 0; i < total.prediction.size(); ++i) {
+        out << std::format("{} \"{}\": {}", i ? "," : "", CASE_NAMES[i], total.prediction[i]);
+    }
+    out << " },\n";
+
+    out << "  \"bits\": { ";
+    if (_has_sizes) {
+        out << std::format("\"connectivity\": {}, \"geometry\": {}, \"connectivity_per_triangle\": {:.4f}, \"geometry_per_vertex\": {:.4f}, ",
+            _sizes.connectivity * 8, _sizes.geometry * 8,
+            _sizes.connectivity * 8.0 / std::max<size_t>(_sizes.triangles, 1),
+            _sizes.geometry * 8.0 / std::max<size_t>(_sizes.vertices, 1));
+    }
+    size_t file_bytes = _mode == "compress" ? _outfile_bytes : _infile_bytes;
+    out << std::format("\"total\": {}, \"per_vertex\": {:.4f} }},\n", file_bytes * 8, file_bytes * 8.0 / std::max<size_t>(total.vertices, 1));
+
+    out << "  \"per_component\": [";
+    for (size_t i = 0; i < _components.size(); ++i) {
+        auto& c = _components[i];
+        out << std::format("{}\n    {{ \"triangles\": {}, \"vertices\": {}, \"dummies\": {}, \"handles\": {}, \"s_count\": {} }}",
+            i ? "," : "", c.triangles, c.vertices, c.dummies, c.handles, c.clers[static_cast<size_t>(CLERS::S)]);
+    }
+    out << (_components.empty() ? "]\n" : "\n  ]\n");
+    out << "}\n";
+}
+
+size_t Stats::peakRSS() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
@@ -0,0 +1,113 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads) {
+    if(threads <= 0){
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    int workers = threads - 1;
+    for(int i = 0; i < std::max(workers, 1); ++i){
+        _queues.push_back(std::make_unique<Queue>());
+    }
+    for(int i = 0; i < workers; ++i){
+        _workers.emplace_back(&ThreadPool::_work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for(auto& w : _workers){
+        w.join();
+    }
+}
+
+int ThreadPool::size() const {
+    return _workers.size() + 1;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    auto& q = *_queues[_next++ % _queues.size()];
+    {
+        std::lock_guard lock(q.mutex);
+        q.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard lock(_mutex);
+        ++_queued;
+        ++_pending;
+    }
+    _wake.notify_one();
+}
+
+void ThreadPool::wait() {
+    while(_runOne(0)) { }
+
+    std::unique_lock lock(_mutex);
+    _done.wait(lock, [this]{ return _pending == 0; });
+
+    if(_error){
+        auto error = _error;
+        _error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::_work(int i) {
+    for(;;){
+        if(_runOne(i)){
+            continue;
+        }
+
+        std::unique_lock lock(_mutex);
+        _wake.wait(lock, [this]{ return _stop || _queued > 0; });
+        if(_stop && _queued == 0){
+            return;
+        }
+    }
+}
+
+bool ThreadPool::_take(int i, std::function<void()>& task) {
+    // Own queue first, then steal from the others. Both ends take from the
+    // front so tasks submitted largest-first are also started largest-first.
+    int n = _queues.size();
+    for(int k = 0; k < n; ++k){
+        auto& q = *_queues[(i + k) % n];
+        std::lock_guard lock(q.mutex);
+        if(!q.tasks.empty()){
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            --_queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::_runOne(int i) {
+    std::function<void()> task;
+    if(!_take(i, task)){
+        return false;
+    }
+
+    try {
+        task();
+    }
+    catch(...) {
+        std::lock_guard lock(_mutex);
+        if(!_error){
+            _error = std::current_exception();
+        }
+    }
+
+    std::lock_guard lock(_mutex);
+    if(--_pending == 0){
+        _done.notify_all();
+    }
+    return true;
+}
@@ -1,28 +1,156 @@
 #include "writer.h"
 
+#include <algorithm>
+
+#include "byte_stream.h"
+#include "bco_format.h"
+#include "range_coder.h"
+#include "residual_coder.h"
+#include "handle_stream.h"
+
+#pragma region HELPERS
+
+// Prefix code C=0, L=110, E=111, R=101, S=100, packed MSB first. The packed
+// byte count is written ahead of the bits. Codes are gathered in a 64-bit
+// accumulator and stored four bytes at a time.
+void packCLERS(
+    const std::vector<CLERS>& clers,
+    ByteWriter& buffer
+) {
+    static constexpr uint8_t CODE[5] = { 0b0, 0b110, 0b111, 0b101, 0b100 };
+    static constexpr uint8_t LENGTH[5] = { 1, 3, 3, 3, 3 };
+
+    std::vector<uint8_t> bytes((clers.size() * 3 + 7) / 8 + 4);
+    uint8_t* out = bytes.data();
+
+    uint64_t bit_buffer = 0;
+    int bit_count = 0;
+    for (auto c : clers) {
+        auto i = static_cast<size_t>(c);
+        if (i >= 5) throw WriterException("Invalid CLERS value");
+        bit_buffer = (bit_buffer << LENGTH[i]) | CODE[i];
+        bit_count += LENGTH[i];
+        if (bit_count >= 32) {
+            bit_count -= 32;
+            uint32_t word = static_cast<uint32_t>(bit_buffer >> bit_count);
+            out[0] = static_cast<uint8_t>(word >> 24);
+            out[1] = static_cast<uint8_t>(word >> 16);
+            out[2] = static_cast<uint8_t>(word >> 8);
+            out[3] = static_cast<uint8_t>(word);
+            out += 4;
+        }
+    }
+
+    // Flush any remaining bits, padded with zeros
+    while (bit_count > 0) {
+        bit_count -= 8;
+        *out++ = static_cast<uint8_t>(bit_count >= 0 ? bit_buffer >> bit_count : bit_buffer << -bit_count);
+    }
+    bytes.resize(out - bytes.data());
+
+    buffer.putVarint(bytes.size());
+    buffer.put(bytes.data(), bytes.size());
+}
+
+// The model starts fresh for every component, which keeps components
+// independently decodable.
+void encodeCLERS(
+    const std::vector<CLERS>& clers,
+    ByteWriter& buffer
+) {
+    RangeEncoder rc;
+    CLERSModel model;
+    for (auto c : clers) {
+        model.encode(rc, c);
+    }
+    rc.finish();
+
+    buffer.putVarint(rc.data().size());
+    buffer.put(rc.data().data(), rc.data().size());
+}
+
+void putRawVertices(
+    const std::vector<Vertex>& vertices,
+    bool quantized,
+    ByteWriter& buffer
+) {
+    if (quantized) {
+        for (auto& v : vertices) {
+            buffer.putSigned(static_cast<int64_t>(v[0]));
+            buffer.putSigned(static_cast<int64_t>(v[1]));
+            buffer.putSigned(static_cast<int64_t>(v[2]));
+        }
+    }
+    else {
+        buffer.put(vertices.data(), vertices.size() * sizeof(Vertex));
+    }
+}
+
+#pragma endregion
+
+
 void Writer::write_OVX(
     const std::string& outfile,
     const std::vector<Vertex>& vert,
     const std::vector<std::tuple<std::vector<int>, std::vector<int>, std::vector<Dummy>>> &ovx
 ) {
-    std::ofstream out(outfile);
+    std::ofstream out(outfile, std::ios::binary);
     if(!out) throw WriterException(std::format("Cannot write to file {}!", outfile));
 
-    out << ovx.size() << "\n";
+    OVXFormat::Header header{};
+    std::copy(std::begin(OVXFormat::MAGIC), std::end(OVXFormat::MAGIC), header.magic);
+    header.version = OVXFormat::VERSION;
+    header.endian = OVXFormat::ENDIAN;
+    header.components = ovx.size();
+
+    std::vector<OVXFormat::Component> table;
+    table.reserve(ovx.size());
     for(auto& [V, O, dummy] : ovx){
-        out << (O.size() / 3) << "\n";
-        for(int i = 0; i < O.size(); ++i){
-            out << V[i] << " " << O[i] << "\n";
-        }
-        out << dummy.size() << "\n";
-        for(auto d : dummy){
-            out << d.first << "\n";
-        }
+        table.push_back({ header.corners, V.size(), header.dummies, dummy.size() });
+        header.corners += V.size();
+        header.dummies += dummy.size();
     }
-    out << vert.size() << "\n";
-    for(auto& v : vert){
-        out << v[0] << " " << v[1] << " " << v[2] << "\n";
+    header.vertices = vert.size();
+
+    header.table_offset = OVXFormat::align(sizeof(header));
+    header.V_offset = OVXFormat::align(header.table_offset + table.size() * sizeof(OVXFormat::Component));
+    header.O_offset = OVXFormat::align(header.V_offset + header.corners * sizeof(int32_t));
+    header.dummy_offset = OVXFormat::align(header.O_offset + header.corners * sizeof(int32_t));
+    header.vert_offset = OVXFormat::align(header.dummy_offset + header.dummies * sizeof(int32_t));
+
+    uint64_t position = 0;
+    auto write = [&](const void* data, uint64_t size){
+        out.write(static_cast<const char*>(data), size);
+        position += size;
+    };
+    auto pad = [&](uint64_t offset){
+        static const char zeros[OVXFormat::ALIGNMENT] = {};
+        write(zeros, offset - position);
+    };
+
+    write(&header, sizeof(header));
+    pad(header.table_offset);
+    write(table.data(), table.size() * sizeof(OVXFormat::Component));
+
+    pad(header.V_offset);
+    for(auto& [V, O, dummy] : ovx){
+        write(V.data(), V.size() * sizeof(int32_t));
+    }
+    pad(header.O_offset);
+    for(auto& [V, O, dummy] : ovx){
+        write(O.data(), O.size() * sizeof(int32_t));
+    }
+    pad(header.dummy_offset);
+    for(auto& [V, O, dummy] : ovx){
+        for(auto& d : dummy){
+            int32_t v = d.first;
+            write(&v, sizeof(v));
+        }
     }
+    pad(header.vert_offset);
+    write(vert.data(), vert.size() * sizeof(Vertex));
+
+    if(!out) throw WriterException(std::format("Cannot write to file {}!", outfile));
 }
 
 void Writer::write_Compressed(
@@ -72,103 +200,20 @@ void Writer::write_Compressed(
     }
 }
 
-void Writer::write_Compressed_BIN(
+BCOSizes Writer::write_Compressed_BIN(
     const std::string &outfile, 
-    const std::vector<std::tuple<std::vector<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>> &compressed
+    const std::vector<std::tuple<std::vector<Vertex>, std::pair<int, std::vector<CLERS>>, std::vector<Handle>, std::vector<Dummy>>> &compressed,
+    const std::vector<ComponentInfo>& info,
+    const Quantization& quant,
+    CLERSCoder clers_coder,
+    VertexCoder vertex_coder
 ) {
-    std::ofstream out(outfile, std::ios::binary);
-    if (!out) throw WriterException(std::format("Cannot write to file {}!", outfile));
-
-    // Write the number of compressed entries
-    size_t count = compressed.size();
-    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
-
-    for (auto& [vertices, clers, handles, dummy] : compressed) {
-        // Write vertices
-        size_t vertex_count = vertices.size();
-        out.write(reinterpret_cast<const char*>(&vertex_count), sizeof(vertex_count));
-        for (auto& v : vertices) {
-            float x = v[0], y = v[1], z = v[2];
-            out.write(reinterpret_cast<const char*>(&x), sizeof(x));
-            out.write(reinterpret_cast<const char*>(&y), sizeof(y));
-            out.write(reinterpret_cast<const char*>(&z), sizeof(z));
-        }
-
-        // Write CLERS data
-        size_t clers_count = clers.second.size();
-        out.write(reinterpret_cast<const char*>(&clers_count), sizeof(clers_count));
-        out.write(reinterpret_cast<const char*>(&clers.first), sizeof(clers.first));
-
-        unsigned char bit_buffer = 0;
-        int bit_pos = 7; // Start at the highest bit
-
-        for (auto c : clers.second) {
-            uint32_t code_value;
-            uint8_t code_length;
-
-            switch (c) {
-                case CLERS::C:
-                    code_value = 0b0;
-                    code_length = 1;
-                    break;
-                case CLERS::L:
-                    code_value = 0b110;
-                    code_length = 3;
-                    break;
-                case CLERS::E:
-                    code_value = 0b111;
-                    code_length = 3;
-                    break;
-                case CLERS::R:
-                    code_value = 0b101;
-                    code_length = 3;
-                    break;
-                case CLERS::S:
-                    code_value = 0b100;
-                    code_length = 3;
-                    break;
-                default:
-                    throw WriterException("Invalid CLERS value");
-            }
-
-            for (int i = code_length - 1; i >= 0; --i) {
-                int bit = (code_value >> i) & 1;
-                if (bit) {
-                    bit_buffer |= (1 << bit_pos);
-                }
-
-                --bit_pos;
-
-                if (bit_pos < 0) {
-                    out.write(reinterpret_cast<const char*>(&bit_buffer), sizeof(bit_buffer));
-                    bit_buffer = 0;
-                    bit_pos = 7;
-                }
-            }
-        }
-
-        // Flush any remaining bits in the buffer
-        if (bit_pos != 7) {
-            out.write(reinterpret_cast<const char*>(&bit_buffer), sizeof(bit_buffer));
-        }
-
-        // Write handles
-        size_t handle_count = handles.size();
-        out.write(reinterpret_cast<const char*>(&handle_count), sizeof(handle_count));
-        for (auto& h : handles) {
-            int h0 = h[0], h1 = h[1];
-            out.write(reinterpret_cast<const char*>(&h0), sizeof(h0));
-            out.write(reinterpret_cast<const char*>(&h1), sizeof(h1));
-        }
-
-        // Write dummy data
-        size_t dummy_count = dummy.size();
-        out.write(reinterpret_cast<const char*>(&dummy_count), sizeof(dummy_count));
-        for (auto& d : dummy) {
-            int val = d.first;
-            out.write(reinterpret_cast<const char*>(&val), sizeof(val));
-        }
+    BCOStreamWriter out(outfile, compressed.size(), quant, clers_coder, vertex_coder);
+    for (size_t i = 0; i < compressed.size(); ++i) {
+        auto& [vertices, clers, handles, dummy] = compressed[i];
+        out.append(vertices, clers, handles, dummy, info[i]);
     }
+    return out.finish();
 }
 
 void Writer::write_OBJ(
@@ -210,4 +255,147 @@ void Writer::write_OFF(
     for (const auto& t : tri) {
         out << "3 " << t[0] << " " << t[1] << " " << t[2] << "\n";
     }
-}
\ No newline at end of file
+}
+
+BCOStreamWriter::BCOStreamWriter(
+    const std::string& outfile,
+    size_t components,
+    const Quantization& quant,
+    CLERSCoder clers_coder,
+    VertexCoder vertex_coder
+) : _outfile(outfile),
+    _out(outfile, std::ios::binary),
+    _components(components),
+    _quantized(quant.bits > 0),
+    _arithmetic_clers(clers_coder == CLERSCoder::ARITHMETIC),
+    _rans_vertices(vertex_coder == VertexCoder::RANS)
+{
+    if (!_out) throw WriterException(std::format("Cannot write to file {}!", outfile));
+    _start(quant);
+}
+
+BCOStreamWriter::BCOStreamWriter(
+    std::vector<uint8_t>& out,
+    size_t components,
+    const Quantization& quant,
+    CLERSCoder clers_coder,
+    VertexCoder vertex_coder
+) : _outfile("buffer"),
+    _target(&out),
+    _components(components),
+    _quantized(quant.bits > 0),
+    _arithmetic_clers(clers_coder == CLERSCoder::ARITHMETIC),
+    _rans_vertices(vertex_coder == VertexCoder::RANS)
+{
+    _start(quant);
+}
+
+void BCOStreamWriter::_start(const Quantization& quant) {
+    uint8_t flags = 0;
+    if (_quantized) flags |= BCOFormat::QUANTIZED;
+    if (_arithmetic_clers) flags |= BCOFormat::ARITHMETIC_CLERS;
+    if (_rans_vertices) flags |= BCOFormat::RANS_VERTICES;
+
+    _buffer.put(BCOFormat::MAGIC, sizeof(BCOFormat::MAGIC));
+    _buffer.putByte(BCOFormat::VERSION);
+    _buffer.putByte(flags);
+    _buffer.put(&BCOFormat::ENDIAN, sizeof(BCOFormat::ENDIAN));
+    if (_quantized) {
+        _buffer.putByte(quant.bits);
+        _buffer.put(quant.min.data(), sizeof(quant.min));
+        _buffer.put(&quant.step, sizeof(quant.step));
+    }
+    _buffer.putVarint(_components);
+    _index.reserve(_components);
+}
+
+void BCOStreamWriter::append(
+    const std::vector<Vertex>& vertices,
+    const std::pair<int, std::vector<CLERS>>& clers,
+    const std::vector<Handle>& handles,
+    const std::vector<Dummy>& dummy,
+    const ComponentInfo& info
+) {
+    if (_appended == _components) throw WriterException(std::format("Too many components for {}!", _outfile));
+    ++_appended;
+
+    size_t start = _buffer.size();
+    _buffer.putVarint(vertices.size());
+    if (_rans_vertices && vertices.size() >= BCOFormat::RANS_MIN_VERTICES) {
+        _buffer.putByte(1);
+        encodeResiduals(vertices, _quantized, _buffer);
+    }
+    else {
+        if (_rans_vertices) _buffer.putByte(0);
+        putRawVertices(vertices, _quantized, _buffer);
+    }
+    size_t geometry_end = _buffer.size();
+
+    _buffer.putVarint(clers.second.size());
+    _buffer.putSigned(clers.first);
+    if (_arithmetic_clers) {
+        encodeCLERS(clers.second, _buffer);
+    }
+    else {
+        packCLERS(clers.second, _buffer);
+    }
+
+    auto handle_stream = encodeHandles(handles);
+    _buffer.putVarint(handle_stream.count);
+    if (handle_stream.count > 0) {
+        _buffer.putVarint(handle_stream.data.size());
+        _buffer.put(handle_stream.data.data(), handle_stream.data.size());
+    }
+
+    _buffer.putVarint(dummy.size());
+    for (auto& d : dummy) {
+        _buffer.putVarint(d.first);
+    }
+
+    auto& entry = _index.emplace_back();
+    entry.offset = _sizes.total + start;
+    entry.size = _buffer.size() - start;
+    entry.triangles = info.triangles;
+    entry.vertices = info.vertices;
+    std::copy(info.min.begin(), info.min.end(), entry.min);
+    std::copy(info.max.begin(), info.max.end(), entry.max);
+
+    _sizes.geometry += geometry_end - start;
+    _sizes.connectivity += _buffer.size() - geometry_end;
+    _sizes.vertices += vertices.size();
+    _sizes.triangles += clers.first + clers.second.size();
+
+    // Small components are gathered so the file sees few large writes.
+    if (_buffer.size() >= (1 << 20)) {
+        _flush();
+    }
+}
+
+BCOSizes BCOStreamWriter::finish() {
+    if (_appended != _components) throw WriterException(std::format("Missing components for {}!", _outfile));
+
+    BCOFormat::Footer footer{};
+    footer.index_offset = _sizes.total + _buffer.size();
+    footer.components = _index.size();
+    std::copy(std::begin(BCOFormat::INDEX_MAGIC), std::end(BCOFormat::INDEX_MAGIC), footer.magic);
+    _buffer.put(_index.data(), _index.size() * sizeof(BCOFormat::IndexEntry));
+    _buffer.put(&footer, sizeof(footer));
+    _flush();
+    if (!_target) {
+        _out.close();
+        if (!_out) throw WriterException(std::format("Cannot write to file {}!", _outfile));
+    }
+    return _sizes;
+}
+
+void BCOStreamWriter::_flush() {
+    if (_target) {
+        _target->insert(_target->end(), _buffer.data().begin(), _buffer.data().end());
+    }
+    else {
+        _out.write(reinterpret_cast<const char*>(_buffer.data().data()), _buffer.size());
+        if (!_out) throw WriterException(std::format("Cannot write to file {}!", _outfile));
+    }
+    _sizes.total += _buffer.size();
+    _buffer.clear();
+}
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <array>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include "edgebreaker.h"
+
+// Round-trips a planar comb, a strip of unit squares with a one-square tooth
+// on every other one. The traversal has to keep one pending split per tooth,
+// so with enough teeth a recursive Compressor overflows the stack. The run is
+// done on a thread with a small stack to catch that.
+
+constexpr size_t STACK_BYTES = 1 << 20;
+
+struct CombTest {
+    size_t teeth = 200000;
+    bool ok = false;
+    std::string error;
+};
+
+void buildComb(size_t teeth, std::vector<Vertex>& vert, std::vector<Indices>& tri) {
+    std::vector<std::array<int, 2>> cells;
+    for (int x = 0; x < static_cast<int>(2 * teeth); ++x) {
+        cells.push_back({ x, 0 });
+    }
+    for (int x = 0; x < static_cast<int>(2 * teeth); x += 2) {
+        cells.push_back({ x, 1 });
+    }
+
+    // Grid points are numbered in the order they are first used.
+    std::vector<int> id((2 * teeth + 1) * 3, -1);
+    auto point = [&](int x, int y) {
+        int& i = id[x * 3 + y];
+        if (i < 0) {
+            i = static_cast<int>(vert.size());
+            vert.push_back({ static_cast<float>(x), static_cast<float>(y), 0.0f });
+        }
+        return i;
+    };
+    for (auto [x, y] : cells) {
+        int a = point(x, y), b = point(x + 1, y), c = point(x + 1, y + 1), d = point(x, y + 1);
+        tri.push_back({ a, b, c });
+        tri.push_back({ a, c, d });
+    }
+}
+
+// Every triangle as its three grid points, rotated to start at the smallest,
+// so meshes can be compared regardless of vertex and triangle order.
+std::vector<std::array<std::array<int, 2>, 3>> canonical(const std::vector<Vertex>& vert, const std::vector<Indices>& tri) {
+    std::vector<std::array<std::array<int, 2>, 3>> result;
+    for (auto& t : tri) {
+        std::array<std::array<int, 2>, 3> p;
+        for (int k = 0; k < 3; ++k) {
+            p[k] = { static_cast<int>(vert[t[k]][0]), static_cast<int>(vert[t[k]][1]) };
+        }
+        std::rotate(p.begin(), std::min_element(p.begin(), p.end()), p.end());
+        result.push_back(p);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void runComb(CombTest& test) {
+    try {
+        std::vector<Vertex> vert;
+        std::vector<Indices> tri;
+        buildComb(test.teeth, vert, tri);
+        auto expected = canonical(vert, tri);
+
+        std::vector<uint8_t> bco;
+        EdgeBreaker::compress(vert, tri, bco);
+
+        for (auto decoder : { ConnectivityDecoder::WRAP_ZIP, ConnectivityDecoder::SPIRALE_REVERSI }) {
+            DecompressOptions options;
+            options.decoder = decoder;
+            std::vector<Vertex> out_vert;
+            std::vector<Indices> out_tri;
+            EdgeBreaker::decompress(bco, out_vert, out_tri, options);
+            if (canonical(out_vert, out_tri) != expected) {
+                test.error = std::format("{} decoder gave a different mesh", decoder == ConnectivityDecoder::WRAP_ZIP ? "wrapzip" : "reversi");
+                return;
+            }
+        }
+        test.ok = true;
+    }
+    catch (const std::exception& e) {
+        test.error = e.what();
+    }
+}
+
+#ifndef _WIN32
+void* runCombThread(void* test) {
+    runComb(*static_cast<CombTest*>(test));
+    return nullptr;
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    CombTest test;
+    if (argc > 1) test.teeth = std::stoull(argv[1]);
+
+#ifdef _WIN32
+    // The main thread's stack is 1 MB there already.
+    runComb(test);
+#else
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, STACK_BYTES);
+    pthread_t thread;
+    if (pthread_create(&thread, &attr, runCombThread, &test) != 0) {
+        std::cerr << "Cannot start the test thread\n";
+        return EXIT_FAILURE;
+    }
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+#endif
+
+    if (!test.ok) {
+        std::cerr << std::format("Comb with {} teeth: {}\n", test.teeth, test.error);
+        return EXIT_FAILURE;
+    }
+    std::cout << std::format("Comb with {} teeth round-trips on a {} KB stack\n", test.teeth, STACK_BYTES / 1024);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,46 @@
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include "rans.h"
+
+// Builds frequency tables from counts big enough that scaling them by
+// RANSTable::TOTAL overflows 32 bits, and checks every frequency stays within
+// a slot or two of its share.
+
+bool checkTable(const std::vector<uint32_t>& counts) {
+    RANSTable table(counts);
+
+    uint64_t total = 0;
+    for (auto c : counts) {
+        total += c;
+    }
+    uint32_t sum = 0;
+    bool ok = true;
+    for (size_t s = 0; s < counts.size(); ++s) {
+        double expected = static_cast<double>(counts[s]) * RANSTable::TOTAL / total;
+        uint32_t freq = table.freq(static_cast<int>(s));
+        sum += freq;
+        if ((counts[s] > 0 && freq == 0) || std::abs(freq - expected) > 2.0) {
+            std::cerr << std::format("Symbol {}: count {}, frequency {}, expected about {:.1f}\n", s, counts[s], freq, expected);
+            ok = false;
+        }
+    }
+    if (sum != RANSTable::TOTAL) {
+        std::cerr << std::format("Frequencies add up to {}, not {}\n", sum, RANSTable::TOTAL);
+        ok = false;
+    }
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+    ok &= checkTable({ 3000000, 2000000, 1000000, 10 });
+    ok &= checkTable({ 1u << 21, 1u << 21 });
+    ok &= checkTable({ 4000000000u, 1, 0, 90000000 });
+    if (!ok) return EXIT_FAILURE;
+    std::cout << "rANS tables are proportional for counts above 2^20\n";
+    return EXIT_SUCCESS;
+}